@@ -0,0 +1,10 @@
+#version 450 core
+
+out vec4 FragColor;
+
+in vec4 color;
+
+void main()
+{
+    FragColor = color;
+}
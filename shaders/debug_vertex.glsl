@@ -0,0 +1,16 @@
+#version 450 core
+
+// World space debug lines streamed every frame, see debug_lines.h
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aColor;
+
+out vec4 color;
+
+#include "scene_blocks.glsl"
+
+void main()
+{
+    gl_Position = viewProj * vec4(aPos, 1.0);
+    color = aColor;
+}
@@ -0,0 +1,126 @@
+#version 450 core
+
+// Single pass mip chain generation. Every workgroup reduces a 64x64 tile of the source level
+// into the next six mips through shared memory, then the last group to finish (found with an
+// atomic counter) reduces the 64x64 top of that chain into up to six more levels.
+// FORMAT, REDUCE and MAX_MIPS are injected by Downsampler
+
+#ifndef FORMAT
+#define FORMAT rgba8
+#endif
+
+#ifndef REDUCE
+#define REDUCE 0    // 0 average, 1 min, 2 max
+#endif
+
+#ifndef MAX_MIPS
+#define MAX_MIPS 12
+#endif
+
+layout (local_size_x = 256) in;
+
+layout (binding = 0) uniform sampler2D source;
+layout (FORMAT, binding = 0) coherent uniform image2D mips[MAX_MIPS];
+
+layout (std430, binding = 0) buffer DownsampleCounter
+{
+    uint finishedGroups;
+};
+
+uniform int sourceLevel;
+uniform int mipCount;
+
+shared vec4 tile[32][32];
+shared bool lastGroup;
+
+vec4 reduce4(vec4 a, vec4 b, vec4 c, vec4 d)
+{
+#if REDUCE == 1
+    return min(min(a, b), min(c, d));
+#elif REDUCE == 2
+    return max(max(a, b), max(c, d));
+#else
+    return (a + b + c + d) * 0.25;
+#endif
+}
+
+vec4 loadSource(ivec2 p)
+{
+    return texelFetch(source, min(p, textureSize(source, sourceLevel) - 1), sourceLevel);
+}
+
+vec4 loadMid(ivec2 p)
+{
+    return imageLoad(mips[5], min(p, imageSize(mips[5]) - 1));
+}
+
+// Reduces the 64x64 block at origin (in the coordinates of the level above mips[firstMip]) into
+// `levels` mips. The first one is read from memory, the rest only go through shared memory
+void downsampleTile(ivec2 origin, int firstMip, int levels, bool fromMid)
+{
+    ivec2 t = ivec2(gl_LocalInvocationIndex % 16u, gl_LocalInvocationIndex / 16u);
+
+    for (int j = 0; j < 2; j++)
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            ivec2 o = t + ivec2(i, j) * 16;
+            ivec2 s = origin + o * 2;
+
+            vec4 v;
+            if (fromMid)
+                v = reduce4(loadMid(s), loadMid(s + ivec2(1, 0)), loadMid(s + ivec2(0, 1)), loadMid(s + ivec2(1, 1)));
+            else
+                v = reduce4(loadSource(s), loadSource(s + ivec2(1, 0)), loadSource(s + ivec2(0, 1)), loadSource(s + ivec2(1, 1)));
+
+            imageStore(mips[firstMip], origin / 2 + o, v);
+            tile[o.y][o.x] = v;
+        }
+    }
+    barrier();
+
+    int size = 32;
+    for (int level = 1; level < levels; level++)
+    {
+        size /= 2;
+        bool inside = t.x < size && t.y < size;
+
+        vec4 v;
+        if (inside)
+            v = reduce4(tile[t.y * 2][t.x * 2], tile[t.y * 2][t.x * 2 + 1], tile[t.y * 2 + 1][t.x * 2], tile[t.y * 2 + 1][t.x * 2 + 1]);
+        barrier();
+
+        if (inside)
+        {
+            tile[t.y][t.x] = v;
+            imageStore(mips[firstMip + level], (origin >> (level + 1)) + t, v);
+        }
+        barrier();
+    }
+}
+
+void main()
+{
+    downsampleTile(ivec2(gl_WorkGroupID.xy) * 64, 0, min(mipCount, 6), false);
+
+    if (mipCount > 6)
+    {
+        // Publish this group's part of mips[5] before counting it as done
+        memoryBarrierImage();
+        barrier();
+
+        if (gl_LocalInvocationIndex == 0u)
+        {
+            uint groups = gl_NumWorkGroups.x * gl_NumWorkGroups.y;
+            lastGroup = atomicAdd(finishedGroups, 1u) == groups - 1u;
+
+            // Ready for the next dispatch
+            if (lastGroup)
+                finishedGroups = 0u;
+        }
+        barrier();
+
+        if (lastGroup)
+            downsampleTile(ivec2(0), 6, mipCount - 6, true);
+    }
+}
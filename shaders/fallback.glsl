@@ -0,0 +1,12 @@
+#version 450 core
+
+// Stand-in drawn while the real programs are still compiling, kept trivial so it builds instantly
+
+out vec4 FragColor;
+
+in vec2 texCoord;
+
+void main()
+{
+   FragColor = vec4(vec3(0.55 + 0.2 * texCoord.x), 1.0);
+}
@@ -3,11 +3,29 @@
 out vec4 FragColor;
 
 in vec2 texCoord;
+flat in ivec2 layers;
+#ifdef FOG
+in float viewDepth;
 
-uniform sampler2D texture1;
-uniform sampler2D texture2;
+// Same as the clear color so distant boxes fade into the background
+const vec3 fogColor = vec3(0.5f, 0.8f, 0.9f);
+const float fogDensity = 0.08f;
+#endif
+
+// Every material texture lives in one array, the object buffer selects the layers. The unit is
+// MATERIAL_LAYERS_UNIT in material.h
+layout (binding = 0) uniform sampler2DArray materialLayers;
 
 void main()
 {
-   FragColor = mix(texture(texture1, texCoord), texture(texture2, texCoord), 0.3);
+   vec4 detail = texture(materialLayers, vec3(texCoord, layers.y));
+#ifdef ALPHA_TEST
+   // Cut out where the detail layer is transparent
+   if (detail.a < 0.5f)
+      discard;
+#endif
+   FragColor = mix(texture(materialLayers, vec3(texCoord, layers.x)), detail, 0.3);
+#ifdef FOG
+   FragColor.rgb = mix(fogColor, FragColor.rgb, exp(-fogDensity * viewDepth));
+#endif
 }
@@ -0,0 +1,25 @@
+// Blocks shared by every scene program, pulled in with #include through ShaderSource
+
+// Written once per frame for every program, see camera.h
+layout (std140, binding = 0) uniform CameraBlock
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+    float time;
+    vec4 viewport;
+};
+
+// One entry per object, see object_block.h. layers.z holds the OBJECT_* flags
+const int OBJECT_HALF_TEXCOORDS = 1;
+
+struct ObjectData
+{
+    mat4 model;
+    ivec4 layers;
+};
+
+layout (std430, binding = 1) readonly buffer ObjectBuffer
+{
+    ObjectData objects[];
+};
@@ -1,16 +1,55 @@
 #version 450 core
 
+#ifdef VERTEX_PULLING
+// Object index of the instance, the command's base instance selects it, see GeometryPool
+layout (location = 3) in uint aObjectIndex;
+#else
+// Quantized, see PackedVertex in mesh.h. Positions are in the snorm16 cube the model matrix decodes.
+// No fragment shader lights anything yet, so the normal at location 2 is not read
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
+#endif
 
 out vec2 texCoord;
+flat out ivec2 layers;
+#ifdef FOG
+out float viewDepth;
+#endif
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "scene_blocks.glsl"
+
+#ifdef VERTEX_PULLING
+// Every mesh of the GeometryPool, three words per PackedVertex: position xy, position z and the
+// octahedral normal, texture coordinate. The normal is not read, nothing is lit yet
+layout (std430, binding = 2) readonly buffer VertexBuffer
+{
+    uint vertexWords[];
+};
+#else
+uniform int objectIndex;
+#endif
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
+#ifdef VERTEX_PULLING
+    int objectIndex = int(aObjectIndex);
+
+    // gl_VertexID already includes the command's base vertex
+    uint base = uint(gl_VertexID) * 3u;
+    uint word0 = vertexWords[base + 0u];
+    uint word1 = vertexWords[base + 1u];
+    uint word2 = vertexWords[base + 2u];
+
+    vec3 aPos = vec3(unpackSnorm2x16(word0), unpackSnorm2x16(word1).x);
+    vec2 aTexCoord = (objects[objectIndex].layers.z & OBJECT_HALF_TEXCOORDS) != 0 ? unpackHalf2x16(word2) : unpackUnorm2x16(word2);
+#endif
+
+    mat4 model = objects[objectIndex].model;
+
+    gl_Position = viewProj * model * vec4(aPos, 1.0f);
     texCoord = vec2(aTexCoord.x, aTexCoord.y);
+    layers = objects[objectIndex].layers.xy;
+#ifdef FOG
+    viewDepth = -(view * model * vec4(aPos, 1.0f)).z;
+#endif
 }
@@ -0,0 +1,25 @@
+#version 450 core
+
+// Writes the virtual texture page each pixel wants, rendered at a fraction of the screen size
+
+layout (location = 0) out uint feedback;
+
+in vec2 texCoord;
+
+uniform vec2 vtSize;
+uniform int vtMaxMip;
+uniform float vtPageSize;
+uniform int vtId;
+uniform float vtFeedbackBias;   // log2 of the feedback downscale, the derivatives are that much larger here
+
+void main()
+{
+    vec2 dx = dFdx(texCoord * vtSize);
+    vec2 dy = dFdy(texCoord * vtSize);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) - vtFeedbackBias;
+
+    int mip = clamp(int(floor(lod)), 0, vtMaxMip);
+    ivec2 page = ivec2(fract(texCoord) * vtSize / (vtPageSize * exp2(float(mip))));
+
+    feedback = (uint(vtId) << 28) | (uint(mip) << 24) | (uint(page.y) << 12) | uint(page.x);
+}
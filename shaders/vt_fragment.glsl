@@ -0,0 +1,43 @@
+#version 450 core
+
+out vec4 FragColor;
+
+in vec2 texCoord;
+
+// Page table entries: cache slot in rg, mip actually resident in b, valid in a. The units are
+// VT_CACHE_UNIT and VT_PAGE_TABLE_UNIT in virtual_texture.h
+layout (binding = 2) uniform usampler2D vtPageTable;
+layout (binding = 1) uniform sampler2D vtCache;
+
+uniform vec2 vtSize;
+uniform int vtMaxMip;
+uniform float vtPageSize;
+uniform float vtBorder;
+uniform float vtCacheSize;
+
+vec4 sampleVirtual(vec2 uv)
+{
+    vec2 dx = dFdx(uv * vtSize);
+    vec2 dy = dFdy(uv * vtSize);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));
+    int mip = clamp(int(floor(lod)), 0, vtMaxMip);
+
+    vec2 texel = fract(uv) * vtSize;
+    ivec2 page = min(ivec2(texel / (vtPageSize * exp2(float(mip)))), textureSize(vtPageTable, mip) - 1);
+    uvec4 entry = texelFetch(vtPageTable, page, mip);
+
+    // Only until the coarsest level has streamed in
+    if (entry.a == 0u)
+        return vec4(0.5, 0.5, 0.5, 1.0);
+
+    // Position inside the page that is resident, which may be coarser than the one requested
+    vec2 local = fract(texel / (vtPageSize * exp2(float(entry.b))));
+    vec2 physical = vec2(entry.rg) * (vtPageSize + 2.0 * vtBorder) + vtBorder + local * vtPageSize;
+
+    return textureLod(vtCache, physical / vtCacheSize, 0.0);
+}
+
+void main()
+{
+    FragColor = sampleVirtual(texCoord);
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+// Compile time checks that a C++ struct has the memory layout GLSL gives the matching uniform
+// or shader storage block. Members are listed in declaration order, padding members are left out:
+//
+//     BLOCK_FIRST(Std140, CameraBlock, view);
+//     BLOCK_NEXT(Std140, CameraBlock, view, projection);
+//     ...
+//     BLOCK_END(Std140, CameraBlock, viewport, 16);
+//
+// A type without a BlockMember rule does not compile, glm::mat3 for instance has no GLSL layout
+// it matches and has to go through PaddedMat3
+enum class BlockLayout
+{
+    Std140,
+    Std430
+};
+
+constexpr std::size_t blockAlign(std::size_t offset, std::size_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// Base alignment and size of a member, only specialized for types whose C++ layout matches
+template<BlockLayout Layout, typename T>
+struct BlockMember;
+
+#define BLOCK_MEMBER_RULE(Type, memberAlignment, memberSize)                    \
+    template<BlockLayout Layout>                                                \
+    struct BlockMember<Layout, Type>                                            \
+    {                                                                           \
+        static_assert(sizeof(Type) == (memberSize), #Type " has an unexpected size"); \
+        static const std::size_t alignment = (memberAlignment);                 \
+        static const std::size_t size = (memberSize);                           \
+    }
+
+BLOCK_MEMBER_RULE(float, 4, 4);
+BLOCK_MEMBER_RULE(std::int32_t, 4, 4);
+BLOCK_MEMBER_RULE(std::uint32_t, 4, 4);
+BLOCK_MEMBER_RULE(glm::vec2, 8, 8);
+BLOCK_MEMBER_RULE(glm::ivec2, 8, 8);
+BLOCK_MEMBER_RULE(glm::uvec2, 8, 8);
+BLOCK_MEMBER_RULE(glm::vec3, 16, 12);
+BLOCK_MEMBER_RULE(glm::ivec3, 16, 12);
+BLOCK_MEMBER_RULE(glm::uvec3, 16, 12);
+BLOCK_MEMBER_RULE(glm::vec4, 16, 16);
+BLOCK_MEMBER_RULE(glm::ivec4, 16, 16);
+BLOCK_MEMBER_RULE(glm::uvec4, 16, 16);
+BLOCK_MEMBER_RULE(glm::mat4, 16, 64);
+
+// Columns of a mat2 are 16 bytes apart in std140 and tightly packed in std430
+template<>
+struct BlockMember<BlockLayout::Std430, glm::mat2>
+{
+    static const std::size_t alignment = 8;
+    static const std::size_t size = 16;
+};
+
+// mat3 with its columns padded to vec4, valid in both layouts
+struct PaddedMat3
+{
+    glm::vec4 columns[3];
+
+    PaddedMat3() {}
+    PaddedMat3(const glm::mat3& mat)
+    {
+        for (int i = 0; i < 3; i++)
+            columns[i] = glm::vec4(mat[i][0], mat[i][1], mat[i][2], 0.0f);
+    }
+};
+
+BLOCK_MEMBER_RULE(PaddedMat3, 16, 48);
+
+// std140 rounds the stride of every array up to 16, std430 keeps the element alignment.
+// The C++ element has to carry the same padding
+template<BlockLayout Layout, typename T, std::size_t N>
+struct BlockMember<Layout, T[N]>
+{
+    static const std::size_t alignment = Layout == BlockLayout::Std140 ? blockAlign(BlockMember<Layout, T>::alignment, 16) : BlockMember<Layout, T>::alignment;
+    static const std::size_t stride = blockAlign(BlockMember<Layout, T>::size, alignment);
+    static const std::size_t size = stride * N;
+
+    static_assert(sizeof(T) == stride, "array element is not padded to the GLSL array stride");
+};
+
+#define BLOCK_MEMBER(Layout, Block, member) BlockMember<BlockLayout::Layout, decltype(Block::member)>
+
+#define BLOCK_FIRST(Layout, Block, member)                                      \
+    static_assert(offsetof(Block, member) == 0, #Block "::" #member " has to come first"); \
+    static_assert(BLOCK_MEMBER(Layout, Block, member)::size > 0, #Block "::" #member " has no GLSL layout")
+
+// member directly follows previous in GLSL, whatever sits between them in C++ is padding
+#define BLOCK_NEXT(Layout, Block, previous, member)                             \
+    static_assert(offsetof(Block, member) ==                                    \
+                  blockAlign(offsetof(Block, previous) + BLOCK_MEMBER(Layout, Block, previous)::size, BLOCK_MEMBER(Layout, Block, member)::alignment), \
+                  #Block "::" #member " is not where " #Layout " puts it")
+
+// Size as an array element of a shader storage block, alignment is 16 in std140 and the largest
+// member alignment in std430
+#define BLOCK_END(Layout, Block, last, blockAlignment)                          \
+    static_assert(sizeof(Block) ==                                              \
+                  blockAlign(offsetof(Block, last) + BLOCK_MEMBER(Layout, Block, last)::size, (blockAlignment)), \
+                  #Block " is not padded the way " #Layout " pads it")
+
+// GPU copy of `count` blocks, rewritten with a single glNamedBufferSubData. Binding is left to the
+// caller, usually through GLStateCache::bindBufferRange
+template<typename T>
+class BlockBuffer
+{
+public:
+    unsigned int ID;
+    std::size_t count;
+
+    explicit BlockBuffer(std::size_t count = 1)
+        : count(count)
+    {
+        glCreateBuffers(1, &ID);
+        glNamedBufferStorage(ID, sizeof(T) * count, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    }
+
+    ~BlockBuffer()
+    {
+        glDeleteBuffers(1, &ID);
+    }
+
+    BlockBuffer(const BlockBuffer&) = delete;
+    BlockBuffer& operator=(const BlockBuffer&) = delete;
+
+    void update(const T& block, std::size_t index = 0)
+    {
+        update(&block, 1, index);
+    }
+
+    void update(const T* blocks, std::size_t blockCount, std::size_t first = 0)
+    {
+        if (first + blockCount > count)
+        {
+            std::cout << "ERROR::BLOCK_BUFFER::OUT_OF_RANGE " << first + blockCount << " > " << count << std::endl;
+            return;
+        }
+
+        glNamedBufferSubData(ID, sizeof(T) * first, sizeof(T) * blockCount, blocks);
+    }
+
+    std::size_t bytes() const { return sizeof(T) * count; }
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "block_layout.h"
+
+#include <glm/glm.hpp>
+
+// Binding point of the CameraBlock uniform block, fixed in the shaders with layout(binding = 0)
+const unsigned int CAMERA_BLOCK_BINDING = 0;
+
+// std140 mirror of CameraBlock in vertex.glsl, written once per frame and shared by every program
+struct CameraBlock
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProj;
+    float time;
+    float padding[3];
+    glm::vec4 viewport;     // width, height, 1 / width, 1 / height
+};
+
+BLOCK_FIRST(Std140, CameraBlock, view);
+BLOCK_NEXT(Std140, CameraBlock, view, projection);
+BLOCK_NEXT(Std140, CameraBlock, projection, viewProj);
+BLOCK_NEXT(Std140, CameraBlock, viewProj, time);
+BLOCK_NEXT(Std140, CameraBlock, time, viewport);
+BLOCK_END(Std140, CameraBlock, viewport, 16);
@@ -0,0 +1,74 @@
+#include "debug_lines.h"
+
+#include "stream_buffer.h"
+
+#include <cstring>
+#include <iostream>
+
+DebugLines::DebugLines(StreamBuffer& stream)
+    : stream(stream)
+{
+}
+
+void DebugLines::line(const glm::vec3& from, const glm::vec3& to, std::uint32_t color)
+{
+    vertices.push_back(DebugVertex{ from, color });
+    vertices.push_back(DebugVertex{ to, color });
+}
+
+void DebugLines::box(const glm::mat4& transform, const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::uint32_t color)
+{
+    glm::vec3 corners[8];
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec3 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y, (i & 4) ? boundsMax.z : boundsMin.z);
+        corners[i] = glm::vec3(transform * glm::vec4(corner, 1.0f));
+    }
+
+    // Every pair of corners one bit apart shares an edge
+    for (int i = 0; i < 8; i++)
+        for (int bit = 1; bit < 8; bit <<= 1)
+            if (!(i & bit))
+                line(corners[i], corners[i | bit], color);
+}
+
+void DebugLines::axes(const glm::mat4& transform, float length)
+{
+    glm::vec3 origin(transform[3]);
+    line(origin, origin + glm::vec3(transform[0]) * length, rgba(1.0f, 0.0f, 0.0f));
+    line(origin, origin + glm::vec3(transform[1]) * length, rgba(0.0f, 1.0f, 0.0f));
+    line(origin, origin + glm::vec3(transform[2]) * length, rgba(0.0f, 0.0f, 1.0f));
+}
+
+unsigned int DebugLines::draw()
+{
+    if (vertices.empty())
+        return 0;
+
+    std::size_t offset;
+    DebugVertex* mapped = stream.allocate<DebugVertex>(vertices.size(), &offset);
+    if (!mapped)
+    {
+        std::cerr << "ERROR::DEBUG_LINES::STREAM_FULL " << vertices.size() << " vertices" << std::endl;
+        vertices.clear();
+        return 0;
+    }
+
+    std::memcpy(mapped, vertices.data(), vertices.size() * sizeof(DebugVertex));
+
+    // The whole stream buffer is bound, each frame's lines are picked through the first vertex
+    DebugVertexLayout::bindBuffers(stream.ID);
+
+    unsigned int count = (unsigned int)vertices.size();
+    glDrawArrays(GL_LINES, (GLint)(offset / sizeof(DebugVertex)), count);
+
+    vertices.clear();
+    return count;
+}
+
+std::uint32_t DebugLines::rgba(float r, float g, float b, float a)
+{
+    // Little endian, so red ends up in the first byte the attribute reads
+    return std::uint32_t(r * 255.0f + 0.5f) | (std::uint32_t(g * 255.0f + 0.5f) << 8) |
+           (std::uint32_t(b * 255.0f + 0.5f) << 16) | (std::uint32_t(a * 255.0f + 0.5f) << 24);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "vertex_layout.h"
+
+class StreamBuffer;
+
+struct DebugVertex
+{
+    glm::vec3 position;
+    std::uint32_t color;    // RGBA8, read as a normalized vec4
+};
+
+typedef VertexLayout<Pos3f, Color4u8n> DebugVertexLayout;
+
+static_assert(sizeof(DebugVertex) == 16, "DebugVertex has to stay tightly packed");
+static_assert(DebugVertexLayout::stride == sizeof(DebugVertex) && DebugVertexLayout::offset<1>() == offsetof(DebugVertex, color),
+              "DebugVertexLayout has to match DebugVertex");
+
+// World space lines collected during the frame and drawn in one call out of a stream buffer.
+// Nothing is uploaded, the vertices are written straight into the buffer's mapped region
+class DebugLines
+{
+public:
+    explicit DebugLines(StreamBuffer& stream);
+
+    DebugLines(const DebugLines&) = delete;
+    DebugLines& operator=(const DebugLines&) = delete;
+
+    // DebugVertexLayout's, fetched on every call like GeometryPool::vao()
+    static unsigned int vao() { return DebugVertexLayout::vao(); }
+
+    void line(const glm::vec3& from, const glm::vec3& to, std::uint32_t color);
+
+    // Box edges of an object space box, transformed by the given matrix
+    void box(const glm::mat4& transform, const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::uint32_t color);
+    void axes(const glm::mat4& transform, float length);
+
+    // Writes the collected lines into the stream buffer's current region and draws them.
+    // Expects the debug line program and vao() to be bound, returns the vertex count drawn
+    unsigned int draw();
+
+    static std::uint32_t rgba(float r, float g, float b, float a = 1.0f);
+
+private:
+    StreamBuffer& stream;
+    std::vector<DebugVertex> vertices;
+};
@@ -0,0 +1,180 @@
+#include "downsampler.h"
+#include "gl_state.h"
+#include "shader_source.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+    // Layout qualifier for the formats image load/store can handle
+    const char* imageFormat(GLint internalFormat)
+    {
+        switch (internalFormat)
+        {
+        case GL_RGBA8:          return "rgba8";
+        case GL_RGBA16:         return "rgba16";
+        case GL_RGBA16F:        return "rgba16f";
+        case GL_RGBA32F:        return "rgba32f";
+        case GL_RG16F:          return "rg16f";
+        case GL_RG32F:          return "rg32f";
+        case GL_R8:             return "r8";
+        case GL_R16F:           return "r16f";
+        case GL_R32F:           return "r32f";
+        case GL_R11F_G11F_B10F: return "r11f_g11f_b10f";
+        default:                return nullptr;
+        }
+    }
+}
+
+Downsampler::Downsampler(const char* computePath)
+    : computePath(computePath)
+{
+    // One image uniform per generated level, at most 12 per dispatch
+    int computeImages = 0;
+    int imageUnits = 0;
+    glGetIntegerv(GL_MAX_COMPUTE_IMAGE_UNIFORMS, &computeImages);
+    glGetIntegerv(GL_MAX_IMAGE_UNITS, &imageUnits);
+    mipsPerDispatch = std::min(12, std::min(computeImages, imageUnits));
+
+    const GLuint zero = 0;
+    glCreateBuffers(1, &counter);
+    glNamedBufferStorage(counter, sizeof(GLuint), &zero, 0);
+}
+
+Downsampler::~Downsampler()
+{
+    for (const auto& entry : programs)
+        glDeleteProgram(entry.second.ID);
+    glDeleteBuffers(1, &counter);
+}
+
+const Downsampler::Program* Downsampler::program(const char* format, Reduction reduction)
+{
+    std::string key = std::string(format) + "/" + std::to_string((int)reduction);
+
+    auto it = programs.find(key);
+    if (it != programs.end())
+        return it->second.ID ? &it->second : nullptr;
+
+    std::string defines = "#define FORMAT " + std::string(format) + "\n" +
+                          "#define REDUCE " + std::to_string((int)reduction) + "\n" +
+                          "#define MAX_MIPS " + std::to_string(mipsPerDispatch) + "\n";
+
+    std::string code;
+    if (!ShaderSource::load(computePath, defines, code))
+    {
+        // Failed variants are remembered too, so they are not rebuilt on every call
+        programs[key] = Program{ 0, -1, -1 };
+        return nullptr;
+    }
+    const char* codePtr = code.c_str();
+
+    int success;
+    char infoLog[1024];
+
+    unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(compute, 1, &codePtr, NULL);
+    glCompileShader(compute);
+    glGetShaderiv(compute, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(compute, 1024, NULL, infoLog);
+        std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: COMPUTE\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+    }
+
+    Program result = { glCreateProgram(), -1, -1 };
+    glAttachShader(result.ID, compute);
+    glLinkProgram(result.ID);
+    glDeleteShader(compute);
+
+    glGetProgramiv(result.ID, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glGetProgramInfoLog(result.ID, 1024, NULL, infoLog);
+        std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: COMPUTE\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+        glDeleteProgram(result.ID);
+        result.ID = 0;
+    }
+    else
+    {
+        result.sourceLevel = glGetUniformLocation(result.ID, "sourceLevel");
+        result.mipCount = glGetUniformLocation(result.ID, "mipCount");
+    }
+
+    // Failed variants are remembered too, so they are not rebuilt on every call
+    Program& stored = programs[key] = result;
+    return stored.ID ? &stored : nullptr;
+}
+
+void Downsampler::generate(unsigned int texture, Reduction reduction, int baseLevel)
+{
+    GLint width = 0;
+    GLint height = 0;
+    GLint internalFormat = 0;
+    GLint immutableLevels = 0;
+    glGetTextureLevelParameteriv(texture, baseLevel, GL_TEXTURE_WIDTH, &width);
+    glGetTextureLevelParameteriv(texture, baseLevel, GL_TEXTURE_HEIGHT, &height);
+    glGetTextureLevelParameteriv(texture, baseLevel, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+    glGetTextureParameteriv(texture, GL_TEXTURE_IMMUTABLE_LEVELS, &immutableLevels);
+
+    int levels = 1;
+    while ((width | height) >> levels)
+        levels++;
+    levels += baseLevel;
+    if (immutableLevels > 0)
+        levels = std::min(levels, (int)immutableLevels);
+
+    const char* format = imageFormat(internalFormat);
+    const Program* prog = format ? program(format, reduction) : nullptr;
+    if (!prog)
+    {
+        if (reduction != Reduction::Average)
+            std::cerr << "ERROR::DOWNSAMPLER::UNSUPPORTED_FORMAT 0x" << std::hex << internalFormat << std::dec << std::endl;
+        glGenerateTextureMipmap(texture);
+        return;
+    }
+
+    if (state)
+    {
+        state->useProgram(prog->ID);
+        state->bindTexture(0, texture);
+        state->bindSampler(0, 0);
+        state->bindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, counter);
+        state->flush();
+    }
+    else
+    {
+        glUseProgram(prog->ID);
+        glBindTextureUnit(0, texture);
+        glBindSampler(0, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, counter);
+    }
+
+    int level = baseLevel;
+    while (level + 1 < levels)
+    {
+        // The last group can only finish a 64x64 block, bigger sources take six levels at a time
+        int count = std::min(levels - 1 - level, mipsPerDispatch);
+        if (width > 4096 || height > 4096)
+            count = std::min(count, 6);
+
+        for (int i = 0; i < count; i++)
+            glBindImageTexture(i, texture, level + 1 + i, GL_FALSE, 0, GL_READ_WRITE, internalFormat);
+
+        glUniform1i(prog->sourceLevel, level);
+        glUniform1i(prog->mipCount, count);
+        glDispatchCompute((width + 63) / 64, (height + 63) / 64, 1);
+
+        // Later dispatches, samplers, copies and render passes all read the result
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT |
+                        GL_TEXTURE_UPDATE_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+
+        level += count;
+        width = std::max(width >> count, 1);
+        height = std::max(height >> count, 1);
+    }
+
+    for (int i = 0; i < mipsPerDispatch; i++)
+        glBindImageTexture(i, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA8);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <unordered_map>
+
+class GLStateCache;
+
+enum class Reduction
+{
+    Average,
+    Min,        // conservative depth pyramids
+    Max         // Hi-Z with reversed depth, luminance peaks
+};
+
+// Builds mip chains with the single pass compute shader in downsample.glsl, a controllable
+// replacement for glGenerateMipmap that also covers render targets (Hi-Z, bloom chains)
+class Downsampler
+{
+public:
+    explicit Downsampler(const char* computePath);
+    ~Downsampler();
+
+    Downsampler(const Downsampler&) = delete;
+    Downsampler& operator=(const Downsampler&) = delete;
+
+    // Rebuilds every level after baseLevel from it. The texture needs mip storage in an image
+    // compatible format, anything else goes through glGenerateTextureMipmap.
+    // Like any 2x2 box reduction, odd edges are dropped on non power of two sizes, so Min/Max
+    // pyramids are only conservative when the target is allocated at a power of two
+    void generate(unsigned int texture, Reduction reduction = Reduction::Average, int baseLevel = 0);
+
+    // Program, texture, sampler and counter binds go through this when set, so they stay in its
+    // mirror. Image units are not mirrored and are left unbound after every generate()
+    GLStateCache* state = nullptr;
+
+private:
+    struct Program
+    {
+        unsigned int ID;
+        int sourceLevel;
+        int mipCount;
+    };
+
+    const Program* program(const char* format, Reduction reduction);
+
+    std::string computePath;
+    std::unordered_map<std::string, Program> programs;
+
+    unsigned int counter;
+    int mipsPerDispatch;
+};
@@ -0,0 +1,188 @@
+#include "geometry_pool.h"
+
+#include "mesh_codec.h"
+#include "mesh_file.h"
+#include "meshlet.h"
+#include "stream_buffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+GeometryPool::GeometryPool(std::size_t maxVertices, std::size_t maxIndices, unsigned int maxObjects)
+    : maxVertices(maxVertices), maxIndices(maxIndices), maxObjects(maxObjects)
+{
+    glCreateBuffers(1, &vertexBuffer);
+    glNamedBufferStorage(vertexBuffer, maxVertices * sizeof(PackedVertex), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    glCreateBuffers(1, &indexBuffer);
+    glNamedBufferStorage(indexBuffer, maxIndices * sizeof(std::uint32_t), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    // Read once per instance, so a command's base instance turns into the object index
+    std::vector<std::uint32_t> objectIndices(maxObjects);
+    for (unsigned int i = 0; i < maxObjects; i++)
+        objectIndices[i] = i;
+
+    glCreateBuffers(1, &objectIndexBuffer);
+    glNamedBufferStorage(objectIndexBuffer, maxObjects * sizeof(std::uint32_t), objectIndices.data(), 0);
+}
+
+GeometryPool::~GeometryPool()
+{
+    VertexLayouts::forgetBuffer(indexBuffer);
+    VertexLayouts::forgetBuffer(objectIndexBuffer);
+
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+    glDeleteBuffers(1, &objectIndexBuffer);
+}
+
+int GeometryPool::add(const PackedMesh& mesh)
+{
+    return add(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size(), mesh.decode, mesh.halfTexCoords, mesh.submeshes, mesh.lods);
+}
+
+int GeometryPool::add(const MeshFile& file, MeshDecoder* decoder)
+{
+    const MeshFileHeader& header = file.header();
+
+    glm::mat4 decode;
+    for (int i = 0; i < 16; i++)
+        decode[i / 4][i % 4] = header.decode[i];
+
+    std::vector<Submesh> submeshes(file.submeshes(), file.submeshes() + header.submeshCount);
+    bool halfTexCoords = (header.flags & MESH_FILE_HALF_TEXCOORDS) != 0;
+    if (!file.compressed())
+        return add(file.vertices(), header.vertexCount, file.indices(), header.indexCount, decode, halfTexCoords, submeshes, file.lods());
+
+    if (usedVertices + header.vertexCount > maxVertices || usedIndices + header.indexCount > maxIndices)
+    {
+        std::cout << "ERROR::GEOMETRY_POOL::FULL " << header.vertexCount << " vertices, " << header.indexCount << " indices do not fit" << std::endl;
+        return -1;
+    }
+
+    // Client storage keeps the upload buffer in cached system memory, so the meshlets can still be
+    // built from the decoded data before the GPU copies it over
+    std::size_t vertexBytes = header.vertexCount * sizeof(PackedVertex);
+    std::size_t uploadBytes = vertexBytes + header.indexCount * sizeof(std::uint32_t);
+    GLbitfield access = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    unsigned int upload;
+    glCreateBuffers(1, &upload);
+    glNamedBufferStorage(upload, std::max<std::size_t>(uploadBytes, 1), nullptr, access | GL_CLIENT_STORAGE_BIT);
+    unsigned char* mapped = static_cast<unsigned char*>(glMapNamedBufferRange(upload, 0, std::max<std::size_t>(uploadBytes, 1), access));
+
+    PackedVertex* vertices = reinterpret_cast<PackedVertex*>(mapped);
+    std::uint32_t* indices = reinterpret_cast<std::uint32_t*>(mapped + vertexBytes);
+
+    int mesh = -1;
+    if (mapped)
+    {
+        bool decoded = decoder ? decoder->decode(file, vertices, indices) : MeshDecoder(0).decode(file, vertices, indices);
+        if (decoded)
+            mesh = add(vertices, header.vertexCount, indices, header.indexCount, decode, halfTexCoords, submeshes, file.lods(), upload);
+        glUnmapNamedBuffer(upload);
+    }
+
+    // The copies already went in, the GL keeps the storage alive until they are done
+    glDeleteBuffers(1, &upload);
+    return mesh;
+}
+
+int GeometryPool::add(const PackedVertex* vertices, std::size_t vertexCount, const std::uint32_t* indices, std::size_t indexCount,
+                      const glm::mat4& decode, bool halfTexCoords, const std::vector<Submesh>& submeshes, const std::vector<MeshLod>& lods,
+                      unsigned int upload)
+{
+    if (usedVertices + vertexCount > maxVertices || usedIndices + indexCount > maxIndices)
+    {
+        std::cout << "ERROR::GEOMETRY_POOL::FULL " << vertexCount << " vertices, " << indexCount << " indices do not fit" << std::endl;
+        return -1;
+    }
+
+    PoolMesh mesh;
+    mesh.baseVertex = std::uint32_t(usedVertices);
+    mesh.vertexCount = std::uint32_t(vertexCount);
+    mesh.firstIndex = std::uint32_t(usedIndices);
+    mesh.indexCount = std::uint32_t(indexCount);
+    mesh.decode = decode;
+    mesh.halfTexCoords = halfTexCoords;
+    mesh.submeshes = submeshes;
+    mesh.lods = lods;
+    if (mesh.lods.empty())
+        mesh.lods.push_back(MeshLod{ 0, std::uint32_t(indexCount), 0.0f, 0 });
+
+    // Level 0 keeps its submesh boundaries, the coarser levels are cut as one range each
+    for (std::size_t level = 0; level < mesh.lods.size(); level++)
+    {
+        std::vector<Submesh> ranges = submeshes;
+        if (level > 0 || ranges.empty())
+            ranges.assign(1, Submesh{ mesh.lods[level].firstIndex, mesh.lods[level].indexCount, glm::vec3(0.0f), glm::vec3(0.0f) });
+        mesh.meshlets.push_back(MeshBuilder::meshlets(vertices, vertexCount, indices, indexCount, ranges, decode));
+    }
+
+    glm::vec3 boundsMin = submeshes.empty() ? glm::vec3(-1.0f) : submeshes[0].boundsMin;
+    glm::vec3 boundsMax = submeshes.empty() ? glm::vec3(1.0f) : submeshes[0].boundsMax;
+    for (const Submesh& submesh : submeshes)
+    {
+        boundsMin = glm::min(boundsMin, submesh.boundsMin);
+        boundsMax = glm::max(boundsMax, submesh.boundsMax);
+    }
+    mesh.center = (boundsMin + boundsMax) * 0.5f;
+    mesh.radius = std::sqrt(glm::dot(boundsMax - mesh.center, boundsMax - mesh.center));
+
+    // Indices stay local to the mesh, the command's base vertex moves them to its vertices. An upload
+    // buffer holds the vertices first and the indices right after them
+    if (upload)
+    {
+        glCopyNamedBufferSubData(upload, vertexBuffer, 0, usedVertices * sizeof(PackedVertex), vertexCount * sizeof(PackedVertex));
+        glCopyNamedBufferSubData(upload, indexBuffer, vertexCount * sizeof(PackedVertex), usedIndices * sizeof(std::uint32_t), indexCount * sizeof(std::uint32_t));
+    }
+    else
+    {
+        glNamedBufferSubData(vertexBuffer, usedVertices * sizeof(PackedVertex), vertexCount * sizeof(PackedVertex), vertices);
+        glNamedBufferSubData(indexBuffer, usedIndices * sizeof(std::uint32_t), indexCount * sizeof(std::uint32_t), indices);
+    }
+
+    usedVertices += vertexCount;
+    usedIndices += indexCount;
+
+    meshes.push_back(mesh);
+    return int(meshes.size() - 1);
+}
+
+void GeometryPool::appendDraw(int mesh, int lod, unsigned int objectIndex, std::vector<DrawElementsIndirectCommand>& commands) const
+{
+    const PoolMesh& entry = meshes[mesh];
+    const MeshLod& level = entry.lods[lod];
+    commands.push_back(DrawElementsIndirectCommand{ level.indexCount, 1, entry.firstIndex + level.firstIndex, GLint(entry.baseVertex), objectIndex });
+}
+
+void GeometryPool::appendRanges(int mesh, unsigned int objectIndex, const std::vector<GLsizei>& counts, const std::vector<const void*>& offsets,
+                                std::vector<DrawElementsIndirectCommand>& commands) const
+{
+    const PoolMesh& entry = meshes[mesh];
+    for (std::size_t i = 0; i < counts.size(); i++)
+    {
+        GLuint first = entry.firstIndex + GLuint(std::uintptr_t(offsets[i]) / sizeof(std::uint32_t));
+        commands.push_back(DrawElementsIndirectCommand{ GLuint(counts[i]), 1, first, GLint(entry.baseVertex), objectIndex });
+    }
+}
+
+void GeometryPool::draw(const std::vector<DrawElementsIndirectCommand>& commands, StreamBuffer& stream) const
+{
+    if (commands.empty())
+        return;
+
+    std::size_t offset;
+    DrawElementsIndirectCommand* mapped = stream.allocate<DrawElementsIndirectCommand>(commands.size(), &offset);
+    if (!mapped)
+    {
+        std::cout << "ERROR::GEOMETRY_POOL::STREAM_FULL " << commands.size() << " commands" << std::endl;
+        return;
+    }
+
+    std::memcpy(mapped, commands.data(), commands.size() * sizeof(DrawElementsIndirectCommand));
+    ObjectIndexLayout::bindBuffers(objectIndexBuffer, indexBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)offset, GLsizei(commands.size()), 0);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+#include "vertex_layout.h"
+
+class MeshDecoder;
+class MeshFile;
+class StreamBuffer;
+
+// Binding point of the VertexBuffer storage block, fixed in vertex.glsl with layout(binding = 2)
+const unsigned int VERTEX_BUFFER_BINDING = 2;
+
+typedef InstanceLayout<ObjectIndex1u> ObjectIndexLayout;
+
+// Laid out as glMultiDrawElementsIndirect reads it
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "DrawElementsIndirectCommand is read by the GL as is");
+
+// Where a mesh ended up inside the pool. Submesh, level and meshlet ranges stay relative to firstIndex
+struct PoolMesh
+{
+    std::uint32_t baseVertex;
+    std::uint32_t vertexCount;
+    std::uint32_t firstIndex;
+    std::uint32_t indexCount;
+
+    glm::mat4 decode;
+    bool halfTexCoords;
+
+    // Object space bounding sphere around every submesh
+    glm::vec3 center;
+    float radius;
+
+    std::vector<Submesh> submeshes;
+
+    // Never empty, meshlets holds one list per level
+    std::vector<MeshLod> lods;
+    std::vector<std::vector<Meshlet>> meshlets;
+};
+
+// Every mesh in one vertex and one index buffer, drawn through a single VAO. The vertex shader
+// fetches PackedVertex data itself from a storage buffer with gl_VertexID (built with
+// VERTEX_PULLING), so meshes no longer need a VAO each and any mix of them goes out in one
+// glMultiDrawElementsIndirect. GL 4.5 has no gl_BaseInstance, the object index comes from an
+// instanced attribute over 0, 1, 2, ... instead, which the base instance of each command offsets
+class GeometryPool
+{
+public:
+    unsigned int vertexBuffer;
+    unsigned int indexBuffer;
+    unsigned int objectIndexBuffer;
+
+    GeometryPool(std::size_t maxVertices, std::size_t maxIndices, unsigned int maxObjects);
+    ~GeometryPool();
+
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool& operator=(const GeometryPool&) = delete;
+
+    // Index of the mesh in the pool, -1 when it does not fit anymore
+    int add(const PackedMesh& mesh);
+
+    // Compressed files are decoded on the decoder's threads, or on this one without a decoder, into a
+    // mapped upload buffer that the GPU then copies into the pool
+    int add(const MeshFile& file, MeshDecoder* decoder = nullptr);
+
+    // ObjectIndexLayout's, shared with any other pool. Fetched on every call, so it is still valid after
+    // VertexLayouts::release()
+    static unsigned int vao() { return ObjectIndexLayout::vao(); }
+
+    const PoolMesh& mesh(int index) const { return meshes[index]; }
+    std::size_t size() const { return meshes.size(); }
+
+    // One command for a whole level of the mesh, drawn for the given object
+    void appendDraw(int mesh, int lod, unsigned int objectIndex, std::vector<DrawElementsIndirectCommand>& commands) const;
+
+    // One command per range, with counts and byte offsets relative to the mesh as MeshletCuller emits them
+    void appendRanges(int mesh, unsigned int objectIndex, const std::vector<GLsizei>& counts, const std::vector<const void*>& offsets,
+                      std::vector<DrawElementsIndirectCommand>& commands) const;
+
+    // The commands go through the stream buffer's current region, no buffer is created or orphaned per frame.
+    // Expects vao(), which draw() points at this pool's buffers, vertexBuffer at VERTEX_BUFFER_BINDING and the stream buffer as GL_DRAW_INDIRECT_BUFFER
+    // to be bound, usually through GLStateCache, and a program built with VERTEX_PULLING
+    void draw(const std::vector<DrawElementsIndirectCommand>& commands, StreamBuffer& stream) const;
+
+private:
+    int add(const PackedVertex* vertices, std::size_t vertexCount, const std::uint32_t* indices, std::size_t indexCount,
+            const glm::mat4& decode, bool halfTexCoords, const std::vector<Submesh>& submeshes, const std::vector<MeshLod>& lods,
+            unsigned int upload = 0);
+
+    std::size_t maxVertices;
+    std::size_t maxIndices;
+    unsigned int maxObjects;
+
+    std::size_t usedVertices = 0;
+    std::size_t usedIndices = 0;
+
+    std::vector<PoolMesh> meshes;
+};
@@ -0,0 +1,284 @@
+#include "gl_state.h"
+
+const unsigned int GLStateCache::UNKNOWN;
+
+GLStateCache::GLStateCache()
+{
+    invalidate();
+}
+
+void GLStateCache::invalidate()
+{
+    program = UNKNOWN;
+    vao = UNKNOWN;
+    framebuffer = UNKNOWN;
+
+    for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+    {
+        textures[i] = pendingTextures[i] = UNKNOWN;
+        samplers[i] = pendingSamplers[i] = UNKNOWN;
+    }
+    unitsDirty = false;
+
+    buffers.clear();
+
+    for (int i = 0; i < MAX_BUFFER_BINDINGS; i++)
+    {
+        uniformBuffers[i] = BufferRange{ UNKNOWN, 0, 0 };
+        storageBuffers[i] = BufferRange{ UNKNOWN, 0, 0 };
+    }
+
+    capabilities.clear();
+
+    blendSource = UNKNOWN;
+    blendDestination = UNKNOWN;
+    depthFunction = UNKNOWN;
+    depthWrite = -1;
+    viewportRect[0] = viewportRect[1] = viewportRect[2] = viewportRect[3] = -1;
+}
+
+void GLStateCache::useProgram(unsigned int program)
+{
+    if (this->program == program)
+    {
+        stats.skipped++;
+        return;
+    }
+
+    this->program = program;
+    glUseProgram(program);
+    stats.issued++;
+}
+
+void GLStateCache::bindVertexArray(unsigned int vao)
+{
+    if (this->vao == vao)
+    {
+        stats.skipped++;
+        return;
+    }
+
+    this->vao = vao;
+    glBindVertexArray(vao);
+    stats.issued++;
+
+    // The index buffer binding comes with the VAO
+    if (unsigned int* slot = bufferSlot(GL_ELEMENT_ARRAY_BUFFER))
+        *slot = UNKNOWN;
+}
+
+void GLStateCache::bindFramebuffer(unsigned int framebuffer)
+{
+    if (this->framebuffer == framebuffer)
+    {
+        stats.skipped++;
+        return;
+    }
+
+    this->framebuffer = framebuffer;
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    stats.issued++;
+}
+
+void GLStateCache::bindTexture(unsigned int unit, unsigned int texture)
+{
+    if (unit >= (unsigned int)MAX_TEXTURE_UNITS)
+    {
+        glBindTextureUnit(unit, texture);
+        stats.issued++;
+        return;
+    }
+
+    pendingTextures[unit] = texture;
+    unitsDirty = true;
+}
+
+void GLStateCache::bindSampler(unsigned int unit, unsigned int sampler)
+{
+    if (unit >= (unsigned int)MAX_TEXTURE_UNITS)
+    {
+        glBindSampler(unit, sampler);
+        stats.issued++;
+        return;
+    }
+
+    pendingSamplers[unit] = sampler;
+    unitsDirty = true;
+}
+
+unsigned int* GLStateCache::bufferSlot(GLenum target)
+{
+    for (std::pair<GLenum, unsigned int>& binding : buffers)
+        if (binding.first == target)
+            return &binding.second;
+    return nullptr;
+}
+
+void GLStateCache::bindBuffer(GLenum target, unsigned int buffer)
+{
+    unsigned int* slot = bufferSlot(target);
+    if (!slot)
+    {
+        buffers.push_back(std::make_pair(target, UNKNOWN));
+        slot = &buffers.back().second;
+    }
+
+    if (*slot == buffer)
+    {
+        stats.skipped++;
+        return;
+    }
+
+    *slot = buffer;
+    glBindBuffer(target, buffer);
+    stats.issued++;
+}
+
+void GLStateCache::bindBufferRange(GLenum target, unsigned int index, unsigned int buffer, GLintptr offset, GLsizeiptr size)
+{
+    BufferRange* ranges = target == GL_UNIFORM_BUFFER ? uniformBuffers : target == GL_SHADER_STORAGE_BUFFER ? storageBuffers : nullptr;
+    if (ranges && index < (unsigned int)MAX_BUFFER_BINDINGS)
+    {
+        BufferRange& range = ranges[index];
+        if (range.buffer == buffer && range.offset == offset && range.size == size)
+        {
+            stats.skipped++;
+            return;
+        }
+        range = BufferRange{ buffer, offset, size };
+    }
+
+    if (size)
+        glBindBufferRange(target, index, buffer, offset, size);
+    else
+        glBindBufferBase(target, index, buffer);
+    stats.issued++;
+
+    // Indexed binds change the generic binding point as well
+    if (unsigned int* slot = bufferSlot(target))
+        *slot = buffer;
+}
+
+void GLStateCache::setEnabled(GLenum capability, bool enabled)
+{
+    int* state = nullptr;
+    for (std::pair<GLenum, int>& entry : capabilities)
+        if (entry.first == capability)
+            state = &entry.second;
+
+    if (!state)
+    {
+        capabilities.push_back(std::make_pair(capability, -1));
+        state = &capabilities.back().second;
+    }
+
+    if (*state == (int)enabled)
+    {
+        stats.skipped++;
+        return;
+    }
+
+    *state = enabled;
+    if (enabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+    stats.issued++;
+}
+
+void GLStateCache::blendFunc(GLenum source, GLenum destination)
+{
+    if (blendSource == source && blendDestination == destination)
+    {
+        stats.skipped++;
+        return;
+    }
+
+    blendSource = source;
+    blendDestination = destination;
+    glBlendFunc(source, destination);
+    stats.issued++;
+}
+
+void GLStateCache::depthFunc(GLenum func)
+{
+    if (depthFunction == func)
+    {
+        stats.skipped++;
+        return;
+    }
+
+    depthFunction = func;
+    glDepthFunc(func);
+    stats.issued++;
+}
+
+void GLStateCache::depthMask(bool write)
+{
+    if (depthWrite == (int)write)
+    {
+        stats.skipped++;
+        return;
+    }
+
+    depthWrite = write;
+    glDepthMask(write ? GL_TRUE : GL_FALSE);
+    stats.issued++;
+}
+
+void GLStateCache::viewport(int x, int y, int width, int height)
+{
+    if (viewportRect[0] == x && viewportRect[1] == y && viewportRect[2] == width && viewportRect[3] == height)
+    {
+        stats.skipped++;
+        return;
+    }
+
+    viewportRect[0] = x;
+    viewportRect[1] = y;
+    viewportRect[2] = width;
+    viewportRect[3] = height;
+    glViewport(x, y, width, height);
+    stats.issued++;
+}
+
+// One multi-bind per run of consecutive changed units
+void GLStateCache::flushUnits(unsigned int* bound, unsigned int* pending, bool samplers)
+{
+    int unit = 0;
+    while (unit < MAX_TEXTURE_UNITS)
+    {
+        if (pending[unit] == UNKNOWN || pending[unit] == bound[unit])
+        {
+            if (pending[unit] != UNKNOWN)
+                stats.skipped++;
+            pending[unit] = UNKNOWN;
+            unit++;
+            continue;
+        }
+
+        int first = unit;
+        while (unit < MAX_TEXTURE_UNITS && pending[unit] != UNKNOWN && pending[unit] != bound[unit])
+        {
+            bound[unit] = pending[unit];
+            pending[unit] = UNKNOWN;
+            unit++;
+        }
+
+        if (samplers)
+            glBindSamplers(first, unit - first, &bound[first]);
+        else
+            glBindTextures(first, unit - first, &bound[first]);
+        stats.issued++;
+    }
+}
+
+void GLStateCache::flush()
+{
+    if (!unitsDirty)
+        return;
+
+    flushUnits(textures, pendingTextures, false);
+    flushUnits(samplers, pendingSamplers, true);
+    unitsDirty = false;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Mirror of the GL state the renderer touches. Every change is compared against the mirror first
+// and only reaches the driver when it actually changes something. Texture and sampler binds are
+// collected and go out as one glBindTextures / glBindSamplers per run of changed units at flush().
+// Code that changes state behind its back has to call invalidate()
+class GLStateCache
+{
+public:
+    static const int MAX_TEXTURE_UNITS = 32;
+    static const int MAX_BUFFER_BINDINGS = 16;
+
+    struct Stats
+    {
+        unsigned int issued = 0;
+        unsigned int skipped = 0;
+    };
+
+    // Reset by the caller, usually once per frame
+    Stats stats;
+
+    GLStateCache();
+
+    GLStateCache(const GLStateCache&) = delete;
+    GLStateCache& operator=(const GLStateCache&) = delete;
+
+    // Forgets everything, the next call of each kind goes through unconditionally
+    void invalidate();
+
+    void useProgram(unsigned int program);
+    void bindVertexArray(unsigned int vao);
+
+    // Draw and read framebuffer together, 0 is the window
+    void bindFramebuffer(unsigned int framebuffer);
+
+    // Deferred until flush()
+    void bindTexture(unsigned int unit, unsigned int texture);
+    void bindSampler(unsigned int unit, unsigned int sampler);
+
+    void bindBuffer(GLenum target, unsigned int buffer);
+
+    // Indexed uniform and shader storage bindings, a size of 0 binds the whole buffer
+    void bindBufferRange(GLenum target, unsigned int index, unsigned int buffer, GLintptr offset = 0, GLsizeiptr size = 0);
+
+    void setEnabled(GLenum capability, bool enabled);
+    void blendFunc(GLenum source, GLenum destination);
+    void depthFunc(GLenum func);
+    void depthMask(bool write);
+    void viewport(int x, int y, int width, int height);
+
+    // Issues the pending texture and sampler binds, call right before a draw or dispatch
+    void flush();
+
+private:
+    static const unsigned int UNKNOWN = 0xFFFFFFFFu;
+
+    struct BufferRange
+    {
+        unsigned int buffer;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+
+    unsigned int* bufferSlot(GLenum target);
+    void flushUnits(unsigned int* bound, unsigned int* pending, bool samplers);
+
+    unsigned int program;
+    unsigned int vao;
+    unsigned int framebuffer;
+
+    unsigned int textures[MAX_TEXTURE_UNITS];
+    unsigned int pendingTextures[MAX_TEXTURE_UNITS];
+    unsigned int samplers[MAX_TEXTURE_UNITS];
+    unsigned int pendingSamplers[MAX_TEXTURE_UNITS];
+    bool unitsDirty;
+
+    // Generic binding points, GL_ELEMENT_ARRAY_BUFFER is part of the VAO and tracked with it
+    std::vector<std::pair<GLenum, unsigned int>> buffers;
+
+    BufferRange uniformBuffers[MAX_BUFFER_BINDINGS];
+    BufferRange storageBuffers[MAX_BUFFER_BINDINGS];
+
+    // -1 unknown, 0 disabled, 1 enabled
+    std::vector<std::pair<GLenum, int>> capabilities;
+
+    GLenum blendSource;
+    GLenum blendDestination;
+    GLenum depthFunction;
+    int depthWrite;
+    int viewportRect[4];
+};
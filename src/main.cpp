@@ -5,10 +5,42 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
-
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "block_layout.h"
+#include "camera.h"
+#include "debug_lines.h"
+#include "downsampler.h"
+#include "geometry_pool.h"
+#include "gl_state.h"
+#include "material.h"
+#include "mesh.h"
+#include "mesh_codec.h"
+#include "mesh_file.h"
+#include "mesh_lod.h"
+#include "meshlet.h"
+#include "object_block.h"
+#include "sampler.h"
 #include "shader.h"
-#include "stb_image.h"
+#include "shader_compiler.h"
+#include "shader_reload.h"
+#include "shader_source.h"
+#include "shader_variants.h"
+#include "static_batch.h"
+#include "stream_buffer.h"
+#include "texture.h"
+#include "uniform_ring.h"
+#include "vertex_layout.h"
+#include "virtual_texture.h"
+
+int framebufferWidth = 800;
+int framebufferHeight = 600;
 
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
@@ -33,10 +65,15 @@ float lastX = float(SCR_WIDTH) / 2.0;
 float lastY = float(SCR_HEIGHT) / 2.0;
 float fov = 45.0f;
 
-int main()
+// Toggled with B, draws object bounds and axes as streamed debug lines
+bool showBounds = false;
+
+int main(int argc, char* argv[])
 {
     // GLFW initialization and specifiying OpenGL window context version 
     glfwInit();
+    // Terminating from atexit lets the GL objects owned by main's locals release their names first
+    std::atexit(glfwTerminate);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -53,6 +90,9 @@ int main()
     // GLFW specific parameters
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+    // Larger than the window on HiDPI screens, the callback only reports later changes
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetCursorPosCallback(window, mouse_callback);
 
@@ -65,7 +105,6 @@ int main()
 
     // Misc GL functions
     glViewport(0, 0, 800, 600);		// Defines the size of the OpenGL rendering viewport, this is independent of window size
-    glEnable(GL_DEPTH_TEST);
 
     // OpenGL version info and GPU currently in use
     std::cout << glGetString(GL_RENDERER) << std::endl;
@@ -75,7 +114,33 @@ int main()
     // Shader compile functions
     //-------------------------------------------------
 
-    Shader ShaderLoader("vertex.glsl", "fragment.glsl");
+    // Every program is submitted up front and builds in the background
+    ShaderCompiler compiler(window);
+
+    // Feature variants of the scene shader, built on first use or ahead of time through precompile
+    ShaderVariants sceneShaders(compiler, "vertex.glsl", "fragment.glsl", { "ALPHA_TEST", "FOG", "VERTEX_PULLING" });
+    const std::uint32_t ALPHA_TEST = sceneShaders.mask("ALPHA_TEST");
+    const std::uint32_t FOG = sceneShaders.mask("FOG");
+    const std::uint32_t VERTEX_PULLING = sceneShaders.mask("VERTEX_PULLING");
+
+    // Drawn with while a variant is still compiling
+    Shader fallbackShader("vertex.glsl", "fallback.glsl", sceneShaders.defines(VERTEX_PULLING));
+
+    Shader debugShader("debug_vertex.glsl", "debug_fragment.glsl");
+
+    // The ground samples a virtual texture, the feedback program writes the pages it wants instead
+    Shader groundShader("vertex.glsl", "vt_fragment.glsl", sceneShaders.defines(VERTEX_PULLING));
+    Shader feedbackShader("vertex.glsl", "vt_feedback.glsl", sceneShaders.defines(VERTEX_PULLING));
+
+    // Saving a shader under shaders/ rebuilds it in the background and swaps it in once it links
+    ShaderHotReload hotReload(compiler);
+#ifdef SHADER_SOURCE_DIR
+    sceneShaders.watch(hotReload, SHADER_SOURCE_DIR "vertex.glsl", SHADER_SOURCE_DIR "fragment.glsl");
+    hotReload.watch(fallbackShader, SHADER_SOURCE_DIR "vertex.glsl", SHADER_SOURCE_DIR "fallback.glsl", sceneShaders.defines(VERTEX_PULLING));
+    hotReload.watch(debugShader, SHADER_SOURCE_DIR "debug_vertex.glsl", SHADER_SOURCE_DIR "debug_fragment.glsl");
+    hotReload.watch(groundShader, SHADER_SOURCE_DIR "vertex.glsl", SHADER_SOURCE_DIR "vt_fragment.glsl", sceneShaders.defines(VERTEX_PULLING));
+    hotReload.watch(feedbackShader, SHADER_SOURCE_DIR "vertex.glsl", SHADER_SOURCE_DIR "vt_feedback.glsl", sceneShaders.defines(VERTEX_PULLING));
+#endif
 
     //-------------------------------------------------
     // Data
@@ -142,109 +207,202 @@ int main()
     // OpenGL buffers
     //-------------------------------------------------
 
-    unsigned int VBO;
-    unsigned int VAO;
-    //unsigned int IBO;
-
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    // The expanded triangle list is only the authoring format, the GPU gets a welded, reordered and quantized mesh
+    std::vector<Vertex> cubeTriangles(sizeof(vertices) / (5 * sizeof(float)));
+    for (std::size_t i = 0; i < cubeTriangles.size(); i++)
+    {
+        cubeTriangles[i].position = glm::vec3(vertices[i * 5 + 0], vertices[i * 5 + 1], vertices[i * 5 + 2]);
+        cubeTriangles[i].texCoord = glm::vec2(vertices[i * 5 + 3], vertices[i * 5 + 4]);
+    }
+    MeshBuilder::faceNormals(cubeTriangles);
 
-    glBindVertexArray(VAO); 	// OpenGL core profile requires a VAO to be bound
+    MeshData cubeMesh = MeshBuilder::build(cubeTriangles, "cube");
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);		// Copies the data from system RAM to GPU RAM
+    // Every mesh shares one vertex and index buffer and is drawn through the same VAO. The moving
+    // cubes come first in the object buffer, the static chunks after them
+    const unsigned int OBJECT_COUNT = 10;
+    const unsigned int MAX_OBJECTS = 1024;
+    GeometryPool geometry(1 << 20, 3 << 20, MAX_OBJECTS);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    std::vector<int> sceneMeshes;
+    sceneMeshes.push_back(geometry.add(MeshBuilder::pack(cubeMesh, "cube")));
 
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    // A .pmesh converted with mesh_convert joins the cube, the objects alternate between them: potato-gfx model.pmesh.
+    // Compressed files are decoded on every core but one while the main thread helps out
+    if (argc > 1)
+    {
+        MeshDecoder decoder;
+        MeshFile meshFile(argv[1]);
+        int loaded = meshFile.valid() ? geometry.add(meshFile, &decoder) : -1;
+        if (loaded >= 0)
+            sceneMeshes.push_back(loaded);
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);	// we can unbind the VBO because it has be registered to the VAO using glVertexAttribPointer
+    // Every instance only draws the meshlets of its level that survive frustum and backface culling
+    std::vector<std::vector<std::unique_ptr<MeshletCuller>>> meshletCullers(geometry.size());
+    for (std::size_t i = 0; i < geometry.size(); i++)
+    {
+        for (const std::vector<Meshlet>& meshlets : geometry.mesh(int(i)).meshlets)
+            meshletCullers[i].emplace_back(new MeshletCuller(meshlets));
+        std::cout << "MESHLETS::BUILT " << geometry.mesh(int(i)).meshlets[0].size() << " meshlets, " << geometry.mesh(int(i)).lods.size() << " levels" << std::endl;
+    }
 
-    //-------------------------------------------------
-    // Texture loading
-    //-------------------------------------------------
+    // A field of small crates below the scene that never moves. They are merged in world space per
+    // material and 16 unit chunk, a few dozen draws instead of one per crate
+    StaticBatcher staticBatcher(16.0f);
+    for (int z = 0; z < 40; z++)
+    {
+        for (int x = 0; x < 40; x++)
+        {
+            unsigned int hash = unsigned(x) * 73856093u ^ unsigned(z) * 19349663u;
+            float scale = 0.25f + float(hash % 7) * 0.05f;
 
-    int width;
-    int height;
-    int nrChannels;
-
-    unsigned int texture1;
-    unsigned int texture2;
-
-    unsigned char* image;
-
-    stbi_set_flip_vertically_on_load(true);
- 
-    //-------------
-    // Texture 1
-    //-------------
-
-    image = stbi_load("container.jpg", &width, &height, &nrChannels, 0);
-         
-    // The usual glGen and glBind
-    glGenTextures(1, &texture1);
-    glBindTexture(GL_TEXTURE_2D, texture1);
-    // Texture wrapping methods
-    glTextureParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTextureParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // Texture filtering method
-    glTextureParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTextureParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // Output the data to be processed by shaders and error checking
-    if(image)
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(float(x) - 20.0f, -4.0f + scale * 0.5f, float(z) - 30.0f));
+            model = glm::rotate(model, glm::radians(float(hash % 360)), glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::scale(model, glm::vec3(scale));
+            staticBatcher.add(cubeMesh, model, int(hash % 3));
+        }
+    }
+    std::vector<StaticChunk> staticChunks = staticBatcher.build(geometry, "crates");
+    if (OBJECT_COUNT + staticChunks.size() + 1 > MAX_OBJECTS)
     {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,GL_UNSIGNED_BYTE, image);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        std::cout << "ERROR::STATIC_BATCH::TOO_MANY_CHUNKS " << staticChunks.size() << std::endl;
+        staticChunks.resize(MAX_OBJECTS - OBJECT_COUNT - 1);
     }
-    else
+    std::vector<std::size_t> visibleChunks;
+
+    // A single quad under the crates, its texture coordinates repeat the virtual texture 8 times.
+    // Its object comes last, after the static chunks
+    const glm::vec2 groundCorners[6] = { glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 0.0f), glm::vec2(1.0f, 1.0f),
+                                         glm::vec2(1.0f, 1.0f), glm::vec2(0.0f, 1.0f), glm::vec2(0.0f, 0.0f) };
+    std::vector<Vertex> groundTriangles(6);
+    for (int i = 0; i < 6; i++)
     {
-        std::cerr << "Texture loading failed" << std::endl;
+        groundTriangles[i].position = glm::vec3(groundCorners[i].x * 2.0f - 1.0f, 0.0f, 1.0f - groundCorners[i].y * 2.0f);
+        groundTriangles[i].texCoord = groundCorners[i] * 8.0f;
     }
-    // Cleanup
-    stbi_image_free(image);
+    MeshBuilder::faceNormals(groundTriangles);
 
-    //-------------
-    // Texture 2
-    //-------------
+    int groundMesh = geometry.add(MeshBuilder::pack(MeshBuilder::build(groundTriangles, "ground"), "ground"));
+    const unsigned int GROUND_OBJECT = OBJECT_COUNT + (unsigned int)staticChunks.size();
+    std::vector<DrawElementsIndirectCommand> groundCommands;
+    geometry.appendDraw(groundMesh, 0, GROUND_OBJECT, groundCommands);
 
-    image = stbi_load("PixelPotato512.png", &width, &height, &nrChannels, 0);
+    // Distant objects switch to coarser levels once their error drops below a pixel
+    LodSelector lodSelector;
+    std::vector<GLsizei> meshletCounts;
+    std::vector<const void*> meshletOffsets;
 
-    glGenTextures(1, &texture2);
-    glBindTexture(GL_TEXTURE_2D, texture2);
+    //-------------------------------------------------
+    // Texture loading
+    //-------------------------------------------------
 
-    glTextureParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTextureParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    // Mip chains come from a compute shader instead of glGenerateMipmap
+    Downsampler downsampler("downsample.glsl");
 
-    glTextureParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTextureParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    TextureRegistry textures;
+    textures.downsampler = &downsampler;
+    textures.flipVertically = true;
 
-    if (image)
-    {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
-    {
-        std::cerr << "Texture loading failed" << std::endl;
-    }
-    
-    stbi_image_free(image);
+    // Materials that share an image share the upload, the registry hands back the same texture
+    TextureHandle container = textures.load("container.jpg");
+    TextureHandle potato = textures.load("PixelPotato512.png");
+    TextureHandle face = textures.load("awesomeface.png");
+
+    textures.printStats();
+
+    // Small pages and a cache of 8x8 of them, far less than the 341 pages of the whole chain, so the
+    // ground really streams. Decoding happens on the texture's worker threads
+    VirtualTextureSettings groundSettings;
+    groundSettings.pageSize = 32;
+    groundSettings.cachePages = 8;
+    VirtualTexture groundTexture(std::unique_ptr<PageSource>(new ImagePageSource("PixelPotato512.png", true)), groundSettings);
+    groundTexture.setUniforms(groundShader, false);
+    groundTexture.setUniforms(feedbackShader, true);
+
+    // Every material repeats and filters linearly, so they all share a single sampler object
+    SamplerCache samplers;
+
+    SamplerState repeatLinear;
+    repeatLinear.minFilter = GL_LINEAR;
+    repeatLinear.magFilter = GL_LINEAR;
+
+    unsigned int sampler = samplers.get(repeatLinear);
+
+    // All the images are 512x512, so they go into the layers of a single array texture
+    TextureArray materialLayers(512, 512, 3);
+
+    int containerLayer = materialLayers.add(container);
+    int potatoLayer = materialLayers.add(potato);
+    int faceLayer = materialLayers.add(face);
+
+    // The array holds its own copy, the standalone textures are not needed anymore
+    container.reset();
+    potato.reset();
+    face.reset();
+
+    Material materials[] = {
+        { containerLayer, potatoLayer, 0 },
+        { containerLayer, faceLayer, FOG },
+        { faceLayer, potatoLayer, ALPHA_TEST | FOG }
+    };
+
+    // Only the combinations the materials use, anything else would still build on first use
+    std::vector<std::uint32_t> usedVariants;
+    for (const Material& material : materials)
+        usedVariants.push_back(material.features | VERTEX_PULLING);
+    sceneShaders.precompile(usedVariants);
 
     //-------------------------------------------------
     // Uniforms
     //-------------------------------------------------
 
-    ShaderLoader.use();
+    // Objects drawn with the same program go out as one multi draw, their commands are collected here
+    std::vector<std::pair<Shader*, std::vector<DrawElementsIndirectCommand>>> drawGroups;
 
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)800/(float)600, 0.1f, 100.0f);
-    ShaderLoader.setMat4("projection", projection);
+    // View and projection go through one uniform block that every program reads at the same binding
+    UniformRing cameraRing(sizeof(CameraBlock));
 
-    // Passing the texture sampler location to OpenGL
-    glUniform1i(glGetUniformLocation(ShaderLoader.ID, "texture1"), 0);
-    glUniform1i(glGetUniformLocation(ShaderLoader.ID, "texture2"), 1);
+    // Per object transforms and material layers. The moving objects are rewritten in one go every
+    // frame, the static chunks only once here
+    std::vector<ObjectData> objects(OBJECT_COUNT + staticChunks.size() + 1);
+    glm::mat4 models[OBJECT_COUNT];
+    BlockBuffer<ObjectData> objectBuffer(objects.size());
 
+    for (std::size_t i = 0; i < staticChunks.size(); i++)
+    {
+        const Material& material = materials[staticChunks[i].material];
+        const PoolMesh& mesh = geometry.mesh(staticChunks[i].mesh);
+        objects[OBJECT_COUNT + i].model = mesh.decode;
+        objects[OBJECT_COUNT + i].layers = glm::ivec4(material.baseLayer, material.detailLayer, mesh.halfTexCoords ? OBJECT_HALF_TEXCOORDS : 0, 0);
+    }
+
+    const PoolMesh& ground = geometry.mesh(groundMesh);
+    glm::mat4 groundModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -4.0f, -10.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(24.0f, 1.0f, 24.0f));
+    objects[GROUND_OBJECT].model = groundModel * ground.decode;
+    objects[GROUND_OBJECT].layers = glm::ivec4(0, 0, ground.halfTexCoords ? OBJECT_HALF_TEXCOORDS : 0, 0);
+    objectBuffer.update(&objects[OBJECT_COUNT], staticChunks.size() + 1, OBJECT_COUNT);
+
+    // Per frame geometry and draw commands are written straight into mapped memory, 64 KiB per frame
+    // covers a few thousand lines or commands
+    StreamBuffer frameStream(64 * 1024);
+    DebugLines debugLines(frameStream);
+
+    // Every bind and toggle in the render loop goes through here, textures loaded from now on
+    // generate their mips through it as well
+    GLStateCache state;
+    downsampler.state = &state;
+
+    // Uniform and state traffic of the last frame, shown in the title once per second
+    UniformStats uniformStats;
+    GLStateCache::Stats stateStats;
+    StreamBuffer::Stats streamStats;
+    MeshletCuller::Stats cullStats;
+    LodSelector::Stats lodStats;
+    StaticBatcher::Stats staticStats;
+    float statsTime = 0.0f;
+
+    bool sourcesReleased = false;
 
     //-------------------------------------------------
     // Main render loop
@@ -258,26 +416,92 @@ int main()
 
         processInput(window);
 
+        uniformStats = Shader::frameStats;
+        Shader::frameStats = UniformStats();
+        stateStats = state.stats;
+        state.stats = GLStateCache::Stats();
+        streamStats = frameStream.stats;
+        frameStream.stats = StreamBuffer::Stats();
+        cullStats = MeshletCuller::Stats();
+        for (std::vector<std::unique_ptr<MeshletCuller>>& levels : meshletCullers)
+        {
+            for (std::unique_ptr<MeshletCuller>& culler : levels)
+            {
+                cullStats.meshlets += culler->stats.meshlets;
+                cullStats.visible += culler->stats.visible;
+                cullStats.trianglesSubmitted += culler->stats.trianglesSubmitted;
+                cullStats.trianglesVisible += culler->stats.trianglesVisible;
+                culler->stats = MeshletCuller::Stats();
+            }
+        }
+        lodStats = lodSelector.stats;
+        lodSelector.stats = LodSelector::Stats();
+        staticStats = staticBatcher.stats;
+        staticBatcher.stats = StaticBatcher::Stats();
+        if (currentFrame - statsTime >= 1.0f)
+        {
+            statsTime = currentFrame;
+            std::string title = "OpenGL Window | uniforms issued " + std::to_string(uniformStats.issued) + " elided " + std::to_string(uniformStats.elided) +
+                                " | state issued " + std::to_string(stateStats.issued) + " skipped " + std::to_string(stateStats.skipped) +
+                                " | stream " + std::to_string(streamStats.bytes) + " bytes waits " + std::to_string(streamStats.waits) +
+                                " | triangles " + std::to_string(cullStats.trianglesVisible) + " / " + std::to_string(cullStats.trianglesSubmitted) +
+                                " | lods " + std::to_string(lodStats.objects[0]) + "/" + std::to_string(lodStats.objects[1]) + "/" +
+                                std::to_string(lodStats.objects[2]) + "/" + std::to_string(lodStats.objects[3]) +
+                                " | static chunks " + std::to_string(staticStats.visible) + " / " + std::to_string(staticStats.chunks);
+            glfwSetWindowTitle(window, title.c_str());
+        }
+
+        // Picks up finished builds without waiting on the driver
+        compiler.poll();
+
+        // Nothing needs the startup sources anymore once they are linked. Lazy variants and hot reloads
+        // keep using the cache afterwards, its size cap bounds what they add
+        if (!sourcesReleased && !compiler.busy())
+        {
+            sourcesReleased = true;
+            std::cout << "SHADER_SOURCE::RELEASED " << ShaderSource::cachedBytes() << " bytes" << std::endl;
+            ShaderSource::clear();
+        }
+
+        // The old program name is free again after a swap, the mirror must not trust it anymore
+        if (hotReload.poll())
+            state.invalidate();
+
+        state.viewport(0, 0, framebufferWidth, framebufferHeight);
+        state.setEnabled(GL_DEPTH_TEST, true);
+        state.depthMask(true);
+
         glClearColor(0.5f, 0.8f, 0.9f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture2);
+        // One bind for every material in the scene
+        state.bindTexture(MATERIAL_LAYERS_UNIT, materialLayers.ID);
+        state.bindSampler(MATERIAL_LAYERS_UNIT, sampler);
 
-        ShaderLoader.use();
+        // A minimized window reports a 0x0 framebuffer
+        float viewportWidth = (float)std::max(framebufferWidth, 1);
+        float viewportHeight = (float)std::max(framebufferHeight, 1);
 
-        glm::mat4 projection = glm::perspective(glm::radians(fov), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        ShaderLoader.setMat4("projection", projection);
+        glm::mat4 projection = glm::perspective(glm::radians(fov), viewportWidth / viewportHeight, 0.1f, 100.0f);
 
         // Look At matrice
         glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        ShaderLoader.setMat4("view", view);
 
-        // Box rendering
-        glBindVertexArray(VAO);
-        for(unsigned int i = 0; i < 10; i++)
+        glm::mat4 viewProj = projection * view;
+
+        // Written straight into GPU visible memory, no upload call per program
+        CameraBlock* camera = cameraRing.begin<CameraBlock>();
+        camera->view = view;
+        camera->projection = projection;
+        camera->viewProj = viewProj;
+        camera->time = currentFrame;
+        camera->viewport = glm::vec4(viewportWidth, viewportHeight, 1.0f / viewportWidth, 1.0f / viewportHeight);
+        cameraRing.bind(state, CAMERA_BLOCK_BINDING);
+
+        // Only blocks when the GPU is several frames behind
+        frameStream.begin();
+
+        for(unsigned int i = 0; i < OBJECT_COUNT; i++)
         {
             glm::mat4 model = glm::mat4(1.0f);
             model = glm::translate(model, cubePositions[i]);
@@ -290,21 +514,121 @@ int main()
                 angle = glfwGetTime() * -25.0f;
 
             model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-            ShaderLoader.setMat4("model", model);
 
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            const Material& material = materials[i % 3];
+            const PoolMesh& mesh = geometry.mesh(sceneMeshes[i % sceneMeshes.size()]);
+            models[i] = model;
+            objects[i].model = model * mesh.decode;
+            objects[i].layers = glm::ivec4(material.baseLayer, material.detailLayer, mesh.halfTexCoords ? OBJECT_HALF_TEXCOORDS : 0, 0);
+
+            if (showBounds)
+            {
+                for (const Submesh& submesh : mesh.submeshes)
+                    debugLines.box(model, submesh.boundsMin, submesh.boundsMax, DebugLines::rgba(1.0f, 1.0f, 0.0f));
+                debugLines.axes(model, 1.0f);
+            }
         }
 
+        objectBuffer.update(objects.data(), OBJECT_COUNT);
+        state.bindBufferRange(GL_SHADER_STORAGE_BUFFER, OBJECT_BUFFER_BINDING, objectBuffer.ID);
+
+        // Box rendering, the visible meshlet ranges of every object are sorted into one command list per program
+        for (auto& group : drawGroups)
+            group.second.clear();
+
+        auto commandsFor = [&](const Material& material) -> std::vector<DrawElementsIndirectCommand>&
+        {
+            Shader* current = sceneShaders.get(material.features | VERTEX_PULLING);
+            if (!current)
+                current = &fallbackShader;
+
+            std::size_t group = 0;
+            while (group < drawGroups.size() && drawGroups[group].first != current)
+                group++;
+            if (group == drawGroups.size())
+                drawGroups.emplace_back(current, std::vector<DrawElementsIndirectCommand>());
+            return drawGroups[group].second;
+        };
+
+        float projectionScale = LodSelector::projectionScale(glm::radians(fov), viewportHeight);
+        for(unsigned int i = 0; i < OBJECT_COUNT; i++)
+        {
+            int mesh = sceneMeshes[i % sceneMeshes.size()];
+            const PoolMesh& poolMesh = geometry.mesh(mesh);
+            int lod = lodSelector.select(i, poolMesh.lods, poolMesh.center, poolMesh.radius, models[i], cameraPos, projectionScale);
+
+            meshletCounts.clear();
+            meshletOffsets.clear();
+            meshletCullers[mesh][lod]->cull(models[i], viewProj, cameraPos, meshletCounts, meshletOffsets);
+            if (meshletCounts.empty())
+                continue;
+
+            geometry.appendRanges(mesh, i, meshletCounts, meshletOffsets, commandsFor(materials[i % 3]));
+        }
+
+        // One command per chunk that survives the frustum test, whatever number of crates it holds
+        visibleChunks.clear();
+        staticBatcher.cull(staticChunks, viewProj, visibleChunks);
+        for (std::size_t chunk : visibleChunks)
+        {
+            geometry.appendDraw(staticChunks[chunk].mesh, 0, OBJECT_COUNT + (unsigned int)chunk, commandsFor(materials[staticChunks[chunk].material]));
+
+            if (showBounds)
+            {
+                for (const Submesh& submesh : geometry.mesh(staticChunks[chunk].mesh).submeshes)
+                    debugLines.box(glm::mat4(1.0f), submesh.boundsMin, submesh.boundsMax, DebugLines::rgba(0.0f, 1.0f, 1.0f));
+            }
+        }
+
+        state.bindVertexArray(geometry.vao());
+        state.bindBufferRange(GL_SHADER_STORAGE_BUFFER, VERTEX_BUFFER_BINDING, geometry.vertexBuffer);
+        state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, frameStream.ID);
+
+        // Pages the ground needs, read back a few frames later. Only the ground is drawn into the
+        // feedback target, anything in front of it merely costs a few extra page requests
+        groundTexture.beginFeedback(state, framebufferWidth, framebufferHeight);
+        state.useProgram(feedbackShader.ID);
+        state.flush();
+        geometry.draw(groundCommands, frameStream);
+        groundTexture.endFeedback(state);
+
+        // Uploads whatever the workers finished, never waits on them or on the readback
+        groundTexture.update();
+
+        for (auto& group : drawGroups)
+        {
+            if (group.second.empty())
+                continue;
+
+            // The sampler unit is fixed in the shader, nothing is set per program
+            Shader* ShaderLoader = group.first;
+            state.useProgram(ShaderLoader->ID);
+            state.flush();
+            geometry.draw(group.second, frameStream);
+        }
+
+        state.useProgram(groundShader.ID);
+        groundTexture.bind(state, VT_CACHE_UNIT, VT_PAGE_TABLE_UNIT);
+        state.flush();
+        geometry.draw(groundCommands, frameStream);
+
+        if (showBounds)
+        {
+            state.useProgram(debugShader.ID);
+            state.bindVertexArray(debugLines.vao());
+            state.flush();
+            debugLines.draw();
+        }
+
+        // The camera and stream regions for this frame are handed over to the GPU
+        cameraRing.end();
+        frameStream.end();
+
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
-    // Resource de-allocation for a cleaner exit. This is optionnal as the OS should handle this automatically
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-
-    glfwTerminate();
-
+    VertexLayouts::release();
     return 0;
 }
 
@@ -313,6 +637,13 @@ void processInput(GLFWwindow *window)
     if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
+    // Edge triggered, holding the key only toggles once
+    static bool boundsKeyDown = false;
+    bool boundsKey = glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS;
+    if (boundsKey && !boundsKeyDown)
+        showBounds = !showBounds;
+    boundsKeyDown = boundsKey;
+
     const float cameraSpeed = 2.5f * deltaTime;
 
     if(glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
@@ -328,7 +659,9 @@ void processInput(GLFWwindow *window)
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    // Applied through the state cache at the start of the next frame
+    framebufferWidth = width;
+    framebufferHeight = height;
 }
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
@@ -0,0 +1,73 @@
+#include "material.h"
+
+#include <iostream>
+
+TextureArray::TextureArray(int width, int height, int capacity)
+    : width(width), height(height), levels(1), capacity(capacity)
+{
+    while ((width | height) >> levels)
+        levels++;
+
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &ID);
+    glTextureStorage3D(ID, levels, GL_RGBA8, width, height, capacity);
+}
+
+TextureArray::~TextureArray()
+{
+    glDeleteTextures(1, &ID);
+}
+
+int TextureArray::add(const TextureHandle& texture)
+{
+    if (!texture)
+        return -1;
+
+    // The registry already hands out one Texture per image, so the handle itself identifies the
+    // image. The weak reference tells a live entry from a freed texture whose address got reused
+    auto it = layers.find(texture.get());
+    if (it != layers.end())
+    {
+        if (!it->second.first.expired())
+            return it->second.second;
+        layers.erase(it);
+    }
+
+    if (texture->width != width || texture->height != height || texture->levels != levels)
+    {
+        std::cerr << "ERROR::TEXTURE_ARRAY::SIZE_MISMATCH " << texture->path << " is " << texture->width << "x" << texture->height
+                  << ", expected " << width << "x" << height << std::endl;
+        return -1;
+    }
+
+    if (count == capacity)
+    {
+        std::cerr << "ERROR::TEXTURE_ARRAY::FULL " << texture->path << std::endl;
+        return -1;
+    }
+
+    // GPU to GPU copy of every mip, nothing is decoded or uploaded again
+    int layer = count++;
+    for (int level = 0; level < levels; level++)
+    {
+        int w = width >> level ? width >> level : 1;
+        int h = height >> level ? height >> level : 1;
+        glCopyImageSubData(texture->ID, GL_TEXTURE_2D, level, 0, 0, 0,
+                           ID, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+                           w, h, 1);
+    }
+
+    layers[texture.get()] = std::make_pair(std::weak_ptr<Texture>(texture), layer);
+    return layer;
+}
+
+std::size_t TextureArray::gpuBytes() const
+{
+    std::size_t bytes = 0;
+    for (int level = 0; level < levels; level++)
+    {
+        std::size_t w = width >> level ? width >> level : 1;
+        std::size_t h = height >> level ? height >> level : 1;
+        bytes += w * h * 4;
+    }
+    return bytes * capacity;
+}
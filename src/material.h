@@ -0,0 +1,49 @@
+#pragma once
+
+#include "texture.h"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+// Texture unit of the material array, fixed in fragment.glsl with layout(binding = 0)
+const unsigned int MATERIAL_LAYERS_UNIT = 0;
+
+// Same-sized textures packed as layers of one GL_TEXTURE_2D_ARRAY, so switching
+// between them is a layer index instead of a texture bind
+class TextureArray
+{
+public:
+    unsigned int ID;
+
+    int width;
+    int height;
+    int levels;
+    int capacity;
+    int count = 0;
+
+    TextureArray(int width, int height, int capacity);
+    ~TextureArray();
+
+    TextureArray(const TextureArray&) = delete;
+    TextureArray& operator=(const TextureArray&) = delete;
+
+    // Copies the texture into the next free layer on the GPU and returns the layer, -1 on failure.
+    // The same texture is only stored once, the source handle can be dropped afterwards
+    int add(const TextureHandle& texture);
+
+    std::size_t gpuBytes() const;
+
+private:
+    std::unordered_map<const Texture*, std::pair<std::weak_ptr<Texture>, int>> layers;
+};
+
+// Per-instance selection of the two layers the fragment shader blends together and of the
+// shader variant drawing them
+struct Material
+{
+    int baseLayer;
+    int detailLayer;
+    std::uint32_t features;     // ShaderVariants mask
+};
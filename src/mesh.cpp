@@ -0,0 +1,488 @@
+#include "mesh.h"
+#include "mesh_lod.h"
+#include "meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <unordered_map>
+
+namespace
+{
+    struct VertexHash
+    {
+        std::size_t operator()(const Vertex& vertex) const
+        {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&vertex);
+            std::size_t hash = 14695981039346656037ull;
+            for (std::size_t i = 0; i < sizeof(Vertex); i++)
+            {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+    };
+
+    struct VertexEqual
+    {
+        bool operator()(const Vertex& a, const Vertex& b) const
+        {
+            return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+        }
+    };
+
+    std::int16_t quantizeSnorm16(float value)
+    {
+        value = std::max(-1.0f, std::min(1.0f, value));
+        return std::int16_t(std::lround(value * 32767.0f));
+    }
+
+    std::int8_t quantizeSnorm8(float value)
+    {
+        value = std::max(-1.0f, std::min(1.0f, value));
+        return std::int8_t(std::lround(value * 127.0f));
+    }
+
+    std::uint16_t quantizeUnorm16(float value)
+    {
+        value = std::max(0.0f, std::min(1.0f, value));
+        return std::uint16_t(std::lround(value * 65535.0f));
+    }
+
+    // IEEE 754 binary16, rounded to nearest. Tiny values flush to zero, huge ones go to infinity
+    std::uint16_t floatToHalf(float value)
+    {
+        std::uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        std::uint32_t sign = (bits >> 16) & 0x8000u;
+        int exponent = int((bits >> 23) & 0xFF) - 127 + 15;
+        std::uint32_t mantissa = bits & 0x7FFFFFu;
+
+        if (((bits >> 23) & 0xFF) == 0xFF)
+            return std::uint16_t(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+        if (exponent <= 0)
+            return std::uint16_t(sign);
+        if (exponent >= 31)
+            return std::uint16_t(sign | 0x7C00u);
+
+        std::uint32_t half = sign | (std::uint32_t(exponent) << 10) | (mantissa >> 13);
+        std::uint32_t rest = mantissa & 0x1FFFu;
+        if (rest > 0x1000u || (rest == 0x1000u && (half & 1u)))
+            half++;     // may carry into the exponent, which is still the right rounding
+        return std::uint16_t(half);
+    }
+
+    // Octahedral mapping of a unit vector onto [-1, 1]^2
+    glm::vec2 octEncode(const glm::vec3& normal)
+    {
+        float sum = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+        if (sum == 0.0f)
+            return glm::vec2(0.0f, 0.0f);
+
+        glm::vec2 p(normal.x / sum, normal.y / sum);
+        if (normal.z < 0.0f)
+        {
+            glm::vec2 folded((1.0f - std::fabs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+                             (1.0f - std::fabs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+            p = folded;
+        }
+        return p;
+    }
+
+    // Triangles using each vertex, as offsets into one flat list
+    struct Adjacency
+    {
+        std::vector<std::uint32_t> offsets;
+        std::vector<std::uint32_t> triangles;
+    };
+
+    Adjacency buildAdjacency(const std::vector<std::uint32_t>& indices, std::size_t vertexCount)
+    {
+        Adjacency adjacency;
+        adjacency.offsets.assign(vertexCount + 1, 0);
+        for (std::uint32_t index : indices)
+            adjacency.offsets[index + 1]++;
+        for (std::size_t i = 0; i < vertexCount; i++)
+            adjacency.offsets[i + 1] += adjacency.offsets[i];
+
+        std::vector<std::uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+        adjacency.triangles.resize(indices.size());
+        for (std::size_t i = 0; i < indices.size(); i++)
+            adjacency.triangles[fill[indices[i]]++] = std::uint32_t(i / 3);
+
+        return adjacency;
+    }
+}
+
+MeshData MeshBuilder::weld(const std::vector<Vertex>& triangleList)
+{
+    MeshData mesh;
+    mesh.indices.reserve(triangleList.size());
+
+    std::unordered_map<Vertex, std::uint32_t, VertexHash, VertexEqual> unique;
+    for (const Vertex& vertex : triangleList)
+    {
+        auto inserted = unique.emplace(vertex, std::uint32_t(mesh.vertices.size()));
+        if (inserted.second)
+            mesh.vertices.push_back(vertex);
+        mesh.indices.push_back(inserted.first->second);
+    }
+    return mesh;
+}
+
+// Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007
+void MeshBuilder::optimizeVertexCache(MeshData& mesh, int cacheSize, std::vector<std::size_t>* clusters)
+{
+    const std::size_t vertexCount = mesh.vertices.size();
+    const std::size_t triangleCount = mesh.indices.size() / 3;
+    if (!triangleCount)
+        return;
+
+    Adjacency adjacency = buildAdjacency(mesh.indices, vertexCount);
+
+    std::vector<int> live(vertexCount);
+    for (std::size_t i = 0; i < vertexCount; i++)
+        live[i] = int(adjacency.offsets[i + 1] - adjacency.offsets[i]);
+
+    std::vector<int> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<std::uint32_t> deadEnd;
+    std::vector<std::uint32_t> output;
+    output.reserve(mesh.indices.size());
+
+    int time = cacheSize + 1;
+    std::size_t cursor = 0;
+    int fanning = 0;
+
+    if (clusters)
+        clusters->push_back(0);
+
+    while (fanning >= 0)
+    {
+        std::vector<std::uint32_t> candidates;
+
+        for (std::uint32_t i = adjacency.offsets[fanning]; i < adjacency.offsets[fanning + 1]; i++)
+        {
+            std::uint32_t triangle = adjacency.triangles[i];
+            if (emitted[triangle])
+                continue;
+
+            for (int corner = 0; corner < 3; corner++)
+            {
+                std::uint32_t vertex = mesh.indices[triangle * 3 + corner];
+                output.push_back(vertex);
+                deadEnd.push_back(vertex);
+                candidates.push_back(vertex);
+                live[vertex]--;
+
+                if (time - cacheTime[vertex] > cacheSize)
+                    cacheTime[vertex] = time++;
+            }
+            emitted[triangle] = true;
+        }
+
+        // Best candidate still in the cache after its remaining triangles are emitted
+        int next = -1;
+        int bestPriority = -1;
+        for (std::uint32_t vertex : candidates)
+        {
+            if (live[vertex] <= 0)
+                continue;
+
+            int priority = 0;
+            if (time - cacheTime[vertex] + 2 * live[vertex] <= cacheSize)
+                priority = time - cacheTime[vertex];
+
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = int(vertex);
+            }
+        }
+
+        if (next < 0)
+        {
+            // Dead end, recently used vertices first and then anything left in input order
+            while (!deadEnd.empty() && next < 0)
+            {
+                std::uint32_t vertex = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[vertex] > 0)
+                    next = int(vertex);
+            }
+
+            while (next < 0 && cursor < vertexCount)
+            {
+                if (live[cursor] > 0)
+                    next = int(cursor);
+                cursor++;
+            }
+
+            if (next >= 0 && clusters)
+                clusters->push_back(output.size() / 3);
+        }
+
+        fanning = next;
+    }
+
+    mesh.indices.swap(output);
+}
+
+void MeshBuilder::optimizeOverdraw(MeshData& mesh, const std::vector<std::size_t>& clusters, const glm::vec3& meshCenter)
+{
+    const std::size_t triangleCount = mesh.indices.size() / 3;
+    if (clusters.size() < 2)
+        return;
+
+    struct Cluster
+    {
+        std::size_t begin;
+        std::size_t end;
+        float sortKey;
+    };
+
+    std::vector<Cluster> order;
+    for (std::size_t i = 0; i < clusters.size(); i++)
+    {
+        Cluster cluster = { clusters[i], i + 1 < clusters.size() ? clusters[i + 1] : triangleCount, 0.0f };
+
+        // Area weighted centroid and normal of the cluster
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (std::size_t triangle = cluster.begin; triangle < cluster.end; triangle++)
+        {
+            const glm::vec3& a = mesh.vertices[mesh.indices[triangle * 3 + 0]].position;
+            const glm::vec3& b = mesh.vertices[mesh.indices[triangle * 3 + 1]].position;
+            const glm::vec3& c = mesh.vertices[mesh.indices[triangle * 3 + 2]].position;
+
+            glm::vec3 cross = glm::cross(b - a, c - a);
+            float weight = glm::length(cross);
+
+            centroid += (a + b + c) * (weight / 3.0f);
+            normal += cross;
+            area += weight;
+        }
+
+        if (area > 0.0f)
+            centroid /= area;
+        if (glm::length(normal) > 0.0f)
+            normal = glm::normalize(normal);
+
+        // Clusters on the outside, facing away from the center, tend to occlude the rest
+        cluster.sortKey = glm::dot(centroid - meshCenter, normal);
+        order.push_back(cluster);
+    }
+
+    std::stable_sort(order.begin(), order.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<std::uint32_t> output;
+    output.reserve(mesh.indices.size());
+    for (const Cluster& cluster : order)
+        output.insert(output.end(), mesh.indices.begin() + cluster.begin * 3, mesh.indices.begin() + cluster.end * 3);
+
+    mesh.indices.swap(output);
+}
+
+void MeshBuilder::optimizeVertexFetch(MeshData& mesh)
+{
+    const std::uint32_t unused = 0xFFFFFFFFu;
+    std::vector<std::uint32_t> remap(mesh.vertices.size(), unused);
+
+    std::vector<Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+
+    for (std::uint32_t& index : mesh.indices)
+    {
+        if (remap[index] == unused)
+        {
+            remap[index] = std::uint32_t(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    mesh.vertices.swap(vertices);
+}
+
+MeshStats MeshBuilder::analyze(const MeshData& mesh, int cacheSize)
+{
+    MeshStats stats = { mesh.vertices.size(), mesh.indices.size() / 3, 0.0f, 0.0f, 0.0f };
+    if (!stats.triangles || !stats.vertices)
+        return stats;
+
+    // FIFO post-transform cache, a miss runs the vertex shader and fetches the vertex
+    std::deque<std::uint32_t> cache;
+    std::vector<bool> inCache(mesh.vertices.size(), false);
+
+    // Small LRU of 64 byte lines standing in for the vertex fetch cache
+    const std::size_t LINE_SIZE = 64;
+    const std::size_t LINES = 32;
+    std::deque<std::size_t> lines;
+
+    std::size_t transforms = 0;
+    std::size_t fetchedBytes = 0;
+
+    for (std::uint32_t index : mesh.indices)
+    {
+        if (inCache[index])
+            continue;
+
+        transforms++;
+        cache.push_back(index);
+        inCache[index] = true;
+        if ((int)cache.size() > cacheSize)
+        {
+            inCache[cache.front()] = false;
+            cache.pop_front();
+        }
+
+        // Strided like the buffer the GPU actually reads
+        std::size_t first = index * sizeof(PackedVertex) / LINE_SIZE;
+        std::size_t last = ((index + 1) * sizeof(PackedVertex) - 1) / LINE_SIZE;
+        for (std::size_t line = first; line <= last; line++)
+        {
+            auto it = std::find(lines.begin(), lines.end(), line);
+            if (it != lines.end())
+            {
+                lines.erase(it);
+            }
+            else
+            {
+                fetchedBytes += LINE_SIZE;
+                if (lines.size() == LINES)
+                    lines.pop_front();
+            }
+            lines.push_back(line);
+        }
+    }
+
+    stats.acmr = float(transforms) / float(stats.triangles);
+    stats.atvr = float(transforms) / float(stats.vertices);
+    stats.overfetch = float(fetchedBytes) / float(stats.vertices * sizeof(PackedVertex));
+    return stats;
+}
+
+void MeshBuilder::faceNormals(std::vector<Vertex>& triangleList)
+{
+    for (std::size_t i = 0; i + 2 < triangleList.size(); i += 3)
+    {
+        glm::vec3 normal = glm::cross(triangleList[i + 1].position - triangleList[i].position, triangleList[i + 2].position - triangleList[i].position);
+        if (glm::length(normal) > 0.0f)
+            normal = glm::normalize(normal);
+
+        for (int corner = 0; corner < 3; corner++)
+            triangleList[i + corner].normal = normal;
+    }
+}
+
+MeshData MeshBuilder::build(const std::vector<Vertex>& triangleList, const std::string& name)
+{
+    MeshData mesh = weld(triangleList);
+    MeshStats before = analyze(mesh);
+
+    std::size_t meshletCount = optimizeMeshlets(mesh);
+    optimizeVertexFetch(mesh);
+
+    MeshStats after = analyze(mesh);
+    std::cout << "MESH::STATS " << name << ": " << triangleList.size() << " vertices welded to " << after.vertices
+              << ", " << after.triangles << " triangles in " << meshletCount << " meshlets"
+              << ", ACMR " << before.acmr << " -> " << after.acmr
+              << ", ATVR " << before.atvr << " -> " << after.atvr
+              << ", overfetch " << before.overfetch << " -> " << after.overfetch << std::endl;
+
+    // Coarser levels only add indices, the vertices and level 0 stay as they are
+    buildLods(mesh, name);
+    return mesh;
+}
+
+PackedMesh MeshBuilder::pack(const MeshData& mesh, const std::string& name)
+{
+    PackedMesh packed;
+    packed.indices = mesh.indices;
+    packed.submeshes = mesh.submeshes;
+    packed.lods = mesh.lods;
+    if (packed.lods.empty())
+        packed.lods.push_back(MeshLod{ 0, std::uint32_t(mesh.indices.size()), 0.0f, 0 });
+    if (packed.submeshes.empty())
+        packed.submeshes.push_back(submesh(mesh, 0, packed.lods[0].indexCount));
+    packed.decode = glm::mat4(1.0f);
+    packed.halfTexCoords = false;
+
+    if (mesh.vertices.empty())
+        return packed;
+
+    glm::vec3 low = mesh.vertices[0].position;
+    glm::vec3 high = low;
+    for (const Vertex& vertex : mesh.vertices)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            low[axis] = std::min(low[axis], vertex.position[axis]);
+            high[axis] = std::max(high[axis], vertex.position[axis]);
+        }
+
+        // unorm16 only covers [0, 1], tiled coordinates fall back to half floats
+        if (vertex.texCoord.x < 0.0f || vertex.texCoord.x > 1.0f || vertex.texCoord.y < 0.0f || vertex.texCoord.y > 1.0f)
+            packed.halfTexCoords = true;
+    }
+
+    glm::vec3 center = (low + high) * 0.5f;
+    glm::vec3 extent = (high - low) * 0.5f;
+    for (int axis = 0; axis < 3; axis++)
+        if (extent[axis] <= 0.0f)
+            extent[axis] = 1.0f;
+
+    // Scale by the half extent, then move to the center
+    packed.decode[0][0] = extent.x;
+    packed.decode[1][1] = extent.y;
+    packed.decode[2][2] = extent.z;
+    packed.decode[3] = glm::vec4(center, 1.0f);
+
+    float maxError = 0.0f;
+    packed.vertices.resize(mesh.vertices.size());
+    for (std::size_t i = 0; i < mesh.vertices.size(); i++)
+    {
+        const Vertex& vertex = mesh.vertices[i];
+        PackedVertex& out = packed.vertices[i];
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            out.position[axis] = quantizeSnorm16((vertex.position[axis] - center[axis]) / extent[axis]);
+
+            // Same decode as GL does for normalized signed integers
+            float decoded = std::max(out.position[axis] / 32767.0f, -1.0f) * extent[axis] + center[axis];
+            maxError = std::max(maxError, std::fabs(decoded - vertex.position[axis]));
+        }
+
+        glm::vec2 oct = octEncode(vertex.normal);
+        out.normal[0] = quantizeSnorm8(oct.x);
+        out.normal[1] = quantizeSnorm8(oct.y);
+
+        for (int axis = 0; axis < 2; axis++)
+            out.texCoord[axis] = packed.halfTexCoords ? floatToHalf(vertex.texCoord[axis]) : quantizeUnorm16(vertex.texCoord[axis]);
+    }
+
+    std::cout << "MESH::PACKED " << name << ": " << mesh.vertices.size() * sizeof(Vertex) << " -> " << packed.vertices.size() * sizeof(PackedVertex)
+              << " vertex bytes, max position error " << maxError << (packed.halfTexCoords ? ", half texture coordinates" : "") << std::endl;
+    return packed;
+}
+
+Submesh MeshBuilder::submesh(const MeshData& mesh, std::uint32_t firstIndex, std::uint32_t indexCount)
+{
+    Submesh range = { firstIndex, indexCount, glm::vec3(0.0f), glm::vec3(0.0f) };
+    for (std::uint32_t i = firstIndex; i < firstIndex + indexCount; i++)
+    {
+        const glm::vec3& position = mesh.vertices[mesh.indices[i]].position;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            range.boundsMin[axis] = i == firstIndex ? position[axis] : std::min(range.boundsMin[axis], position[axis]);
+            range.boundsMax[axis] = i == firstIndex ? position[axis] : std::max(range.boundsMax[axis], position[axis]);
+        }
+    }
+    return range;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Full precision vertex the mesh builder works on, the GPU only ever sees PackedVertex
+struct Vertex
+{
+    glm::vec3 position;
+    glm::vec2 texCoord;
+    glm::vec3 normal;
+};
+
+static_assert(sizeof(Vertex) == 8 * sizeof(float), "Vertex has to stay tightly packed");
+
+// 12 byte GPU vertex. Attribute 0 is the position as snorm16 inside the mesh bounds, 1 the texture
+// coordinate as unorm16 (half floats when it leaves [0, 1]) and 2 the octahedral normal as snorm8
+struct PackedVertex
+{
+    std::int16_t position[3];
+    std::int8_t normal[2];
+    std::uint16_t texCoord[2];
+};
+
+static_assert(sizeof(PackedVertex) == 12, "PackedVertex has to stay tightly packed");
+
+// Range of the index buffer drawn with one material, bounds are in object space
+struct Submesh
+{
+    std::uint32_t firstIndex;
+    std::uint32_t indexCount;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+};
+
+static_assert(sizeof(Submesh) == 32, "Submesh is stored as is in mesh files");
+
+// One level of detail, a range of the index buffer over the same vertices as every other level.
+// Level 0 is the full mesh, error is the largest object space deviation the simplifier allowed
+struct MeshLod
+{
+    std::uint32_t firstIndex;
+    std::uint32_t indexCount;
+    float error;
+    std::uint32_t reserved;
+};
+
+static_assert(sizeof(MeshLod) == 16, "MeshLod is stored as is in mesh files");
+
+// Contiguous range of a mesh's index buffer small enough to be culled on its own. Bounds are in
+// object space. The normal cone covers every triangle normal, a cutoff of 1 means it never culls
+struct Meshlet
+{
+    std::uint32_t firstIndex;
+    std::uint32_t triangleCount;
+    std::uint32_t vertexCount;
+
+    glm::vec3 center;
+    float radius;
+
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+struct MeshData
+{
+    std::vector<Vertex> vertices;
+    std::vector<std::uint32_t> indices;
+
+    // Empty means a single range over every index. Submeshes only cover level 0
+    std::vector<Submesh> submeshes;
+
+    // Empty means a single level over every index, otherwise level 0 starts the index buffer
+    std::vector<MeshLod> lods;
+};
+
+// Post-transform cache and vertex fetch behavior of an index buffer
+struct MeshStats
+{
+    std::size_t vertices;
+    std::size_t triangles;
+
+    float acmr;         // vertex shader runs per triangle, 0.5 is the best case for closed meshes
+    float atvr;         // vertex shader runs per vertex, 1 means every vertex is transformed once
+    float overfetch;    // bytes read from the PackedVertex buffer over its size
+};
+
+struct PackedMesh
+{
+    std::vector<PackedVertex> vertices;
+    std::vector<std::uint32_t> indices;
+    std::vector<Submesh> submeshes;
+    std::vector<MeshLod> lods;
+
+    // Maps the snorm16 cube back to object space, goes in front of the model matrix
+    glm::mat4 decode;
+
+    bool halfTexCoords;
+};
+
+// Offline style mesh optimization, run once at load time. build() welds, cuts the mesh into meshlets
+// with the vertex cache and overdraw passes run inside each of them, then optimizes vertex fetch
+namespace MeshBuilder
+{
+    const int CACHE_SIZE = 16;
+
+    // Merges bitwise identical vertices of a triangle list into an index buffer
+    MeshData weld(const std::vector<Vertex>& triangleList);
+
+    // Tipsify triangle order for a FIFO cache of cacheSize entries. Each cluster start (a triangle
+    // index where the order jumped because the cache ran dry) is appended to clusters if given
+    void optimizeVertexCache(MeshData& mesh, int cacheSize = CACHE_SIZE, std::vector<std::size_t>* clusters = nullptr);
+
+    // Reorders the clusters so the ones facing away from meshCenter come first. Triangles inside a
+    // cluster keep their order, so the cache behavior is mostly preserved
+    void optimizeOverdraw(MeshData& mesh, const std::vector<std::size_t>& clusters, const glm::vec3& meshCenter);
+
+    // Renumbers vertices in order of first use, unused ones are dropped
+    void optimizeVertexFetch(MeshData& mesh);
+
+    MeshStats analyze(const MeshData& mesh, int cacheSize = CACHE_SIZE);
+
+    // Flat normals for a triangle list, every corner gets the normal of its triangle
+    void faceNormals(std::vector<Vertex>& triangleList);
+
+    // All of the above, printing the statistics before and after
+    MeshData build(const std::vector<Vertex>& triangleList, const std::string& name);
+
+    // Quantizes to PackedVertex, printing the memory saved and the largest position error
+    PackedMesh pack(const MeshData& mesh, const std::string& name);
+
+    // Bounds of the vertices referenced by a range of indices
+    Submesh submesh(const MeshData& mesh, std::uint32_t firstIndex, std::uint32_t indexCount);
+}
@@ -0,0 +1,586 @@
+#include "mesh_codec.h"
+
+#include "mesh_file.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESH_CODEC_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    const std::size_t GROUP_SIZE = 16;
+    const std::size_t MAX_STRIDE = 16;
+
+    // Blocks per decoder job, small enough to keep every thread busy on mid sized meshes
+    const std::uint32_t JOB_BLOCKS = 16;
+
+    // Start of an encoded stream, followed by blocks + 1 offsets from the start of the stream, the
+    // last one being the end of the final block
+    struct StreamHeader
+    {
+        std::uint32_t count;
+        std::uint32_t stride;
+        std::uint32_t blocks;
+        std::uint32_t reserved;
+    };
+
+    const std::size_t GROUP_BYTES[4] = { 0, 4, 8, 16 };
+
+    std::uint8_t zigzag8(std::uint8_t current, std::uint8_t previous)
+    {
+        std::int8_t delta = std::int8_t(std::uint8_t(current - previous));
+        return std::uint8_t((delta << 1) ^ (delta >> 7));
+    }
+
+    std::uint32_t zigzag32(std::uint32_t current, std::uint32_t previous)
+    {
+        std::int32_t delta = std::int32_t(current - previous);
+        return (std::uint32_t(delta) << 1) ^ std::uint32_t(delta >> 31);
+    }
+
+    // Elements are already filtered, element major. Every block stores its planes one after the other
+    std::vector<unsigned char> encodeStream(const unsigned char* filtered, std::size_t count, std::size_t stride)
+    {
+        StreamHeader header = { std::uint32_t(count), std::uint32_t(stride), std::uint32_t((count + MeshCodec::BLOCK_ELEMENTS - 1) / MeshCodec::BLOCK_ELEMENTS), 0 };
+
+        std::vector<std::uint32_t> offsets(header.blocks + 1);
+        std::vector<unsigned char> stream(sizeof(StreamHeader) + offsets.size() * sizeof(std::uint32_t));
+
+        unsigned char group[GROUP_SIZE];
+        for (std::uint32_t block = 0; block < header.blocks; block++)
+        {
+            offsets[block] = std::uint32_t(stream.size());
+
+            std::size_t first = std::size_t(block) * MeshCodec::BLOCK_ELEMENTS;
+            std::size_t elements = std::min<std::size_t>(MeshCodec::BLOCK_ELEMENTS, count - first);
+            std::size_t groups = (elements + GROUP_SIZE - 1) / GROUP_SIZE;
+
+            for (std::size_t plane = 0; plane < stride; plane++)
+            {
+                std::size_t headerStart = stream.size();
+                stream.resize(stream.size() + (groups + 3) / 4, 0);
+
+                for (std::size_t g = 0; g < groups; g++)
+                {
+                    unsigned char largest = 0;
+                    for (std::size_t i = 0; i < GROUP_SIZE; i++)
+                    {
+                        std::size_t element = g * GROUP_SIZE + i;
+                        group[i] = element < elements ? filtered[(first + element) * stride + plane] : 0;
+                        largest = std::max(largest, group[i]);
+                    }
+
+                    int code = largest == 0 ? 0 : largest < 4 ? 1 : largest < 16 ? 2 : 3;
+                    stream[headerStart + g / 4] |= std::uint8_t(code << ((g % 4) * 2));
+
+                    std::size_t payload = stream.size();
+                    stream.resize(payload + GROUP_BYTES[code], 0);
+                    for (std::size_t i = 0; i < GROUP_SIZE && code; i++)
+                    {
+                        if (code == 1)
+                            stream[payload + i / 4] |= std::uint8_t(group[i] << ((i % 4) * 2));
+                        else if (code == 2)
+                            stream[payload + i / 2] |= std::uint8_t(group[i] << ((i % 2) * 4));
+                        else
+                            stream[payload + i] = group[i];
+                    }
+                }
+            }
+        }
+        offsets[header.blocks] = std::uint32_t(stream.size());
+
+        std::memcpy(stream.data(), &header, sizeof(header));
+        std::memcpy(stream.data() + sizeof(header), offsets.data(), offsets.size() * sizeof(std::uint32_t));
+        return stream;
+    }
+
+    bool validStream(const unsigned char* stream, std::size_t size, std::size_t count, std::size_t stride)
+    {
+        StreamHeader header;
+        if (size < sizeof(header))
+            return false;
+        std::memcpy(&header, stream, sizeof(header));
+
+        std::size_t tableEnd = sizeof(header) + (std::size_t(header.blocks) + 1) * sizeof(std::uint32_t);
+        if (header.count != count || header.stride != stride ||
+            header.blocks != (count + MeshCodec::BLOCK_ELEMENTS - 1) / MeshCodec::BLOCK_ELEMENTS || tableEnd > size)
+            return false;
+
+        std::uint32_t previous = std::uint32_t(tableEnd);
+        for (std::uint32_t i = 0; i <= header.blocks; i++)
+        {
+            std::uint32_t offset;
+            std::memcpy(&offset, stream + sizeof(header) + i * sizeof(std::uint32_t), sizeof(offset));
+            if (offset < previous || offset > size)
+                return false;
+            previous = offset;
+        }
+        return true;
+    }
+
+    std::uint32_t blockOffset(const unsigned char* stream, std::uint32_t block)
+    {
+        std::uint32_t offset;
+        std::memcpy(&offset, stream + sizeof(StreamHeader) + block * sizeof(std::uint32_t), sizeof(offset));
+        return offset;
+    }
+
+    // Unpacks every plane of one block into planes[plane * BLOCK_ELEMENTS], groups past the last
+    // element come out as zero. Returns the element count, 0 when the block runs past its end
+    std::size_t unpackBlock(const unsigned char* stream, std::uint32_t block, unsigned char* planes)
+    {
+        StreamHeader header;
+        std::memcpy(&header, stream, sizeof(header));
+
+        const unsigned char* data = stream + blockOffset(stream, block);
+        const unsigned char* end = stream + blockOffset(stream, block + 1);
+
+        std::size_t first = std::size_t(block) * MeshCodec::BLOCK_ELEMENTS;
+        std::size_t elements = std::min<std::size_t>(MeshCodec::BLOCK_ELEMENTS, header.count - first);
+        std::size_t groups = (elements + GROUP_SIZE - 1) / GROUP_SIZE;
+        std::size_t headerBytes = (groups + 3) / 4;
+
+        for (std::size_t plane = 0; plane < header.stride; plane++)
+        {
+            const unsigned char* codes = data;
+            if (std::size_t(end - data) < headerBytes)
+                return 0;
+            data += headerBytes;
+
+            std::size_t payload = 0;
+            for (std::size_t g = 0; g < groups; g++)
+                payload += GROUP_BYTES[(codes[g / 4] >> ((g % 4) * 2)) & 3];
+            if (std::size_t(end - data) < payload)
+                return 0;
+
+            unsigned char* out = planes + plane * MeshCodec::BLOCK_ELEMENTS;
+            for (std::size_t g = 0; g < groups; g++, out += GROUP_SIZE)
+            {
+                int code = (codes[g / 4] >> ((g % 4) * 2)) & 3;
+#ifdef MESH_CODEC_SSE
+                __m128i values;
+                if (code == 0)
+                {
+                    values = _mm_setzero_si128();
+                }
+                else if (code == 1)
+                {
+                    // Byte j holds values 4j to 4j + 3 from the lowest bits up
+                    int packed;
+                    std::memcpy(&packed, data, sizeof(packed));
+                    __m128i v = _mm_cvtsi32_si128(packed);
+                    __m128i mask = _mm_set1_epi8(3);
+                    __m128i a = _mm_and_si128(v, mask);
+                    __m128i b = _mm_and_si128(_mm_srli_epi16(v, 2), mask);
+                    __m128i c = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+                    __m128i d = _mm_and_si128(_mm_srli_epi16(v, 6), mask);
+                    values = _mm_unpacklo_epi16(_mm_unpacklo_epi8(a, b), _mm_unpacklo_epi8(c, d));
+                }
+                else if (code == 2)
+                {
+                    __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data));
+                    __m128i mask = _mm_set1_epi8(15);
+                    values = _mm_unpacklo_epi8(_mm_and_si128(v, mask), _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+                }
+                else
+                {
+                    values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+                }
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), values);
+#else
+                for (std::size_t i = 0; i < GROUP_SIZE; i++)
+                {
+                    if (code == 0)
+                        out[i] = 0;
+                    else if (code == 1)
+                        out[i] = (data[i / 4] >> ((i % 4) * 2)) & 3;
+                    else if (code == 2)
+                        out[i] = (data[i / 2] >> ((i % 2) * 4)) & 15;
+                    else
+                        out[i] = data[i];
+                }
+#endif
+                data += GROUP_BYTES[code];
+            }
+        }
+        return elements;
+    }
+
+#ifdef MESH_CODEC_SSE
+    __m128i unzigzag8(__m128i value)
+    {
+        __m128i half = _mm_and_si128(_mm_srli_epi16(value, 1), _mm_set1_epi8(0x7F));
+        __m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(value, _mm_set1_epi8(1)));
+        return _mm_xor_si128(half, sign);
+    }
+
+    __m128i unzigzag32(__m128i value)
+    {
+        __m128i sign = _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(value, _mm_set1_epi32(1)));
+        return _mm_xor_si128(_mm_srli_epi32(value, 1), sign);
+    }
+
+    // Running sum of the bytes, plus the last sum of the previous group broadcast in carry
+    __m128i prefix8(__m128i value, __m128i& carry)
+    {
+        value = _mm_add_epi8(value, _mm_slli_si128(value, 1));
+        value = _mm_add_epi8(value, _mm_slli_si128(value, 2));
+        value = _mm_add_epi8(value, _mm_slli_si128(value, 4));
+        value = _mm_add_epi8(value, _mm_slli_si128(value, 8));
+        value = _mm_add_epi8(value, carry);
+
+        __m128i last = _mm_unpackhi_epi8(value, value);
+        last = _mm_unpackhi_epi16(last, last);
+        carry = _mm_shuffle_epi32(last, 0xFF);
+        return value;
+    }
+
+    __m128i prefix32(__m128i value, __m128i& carry)
+    {
+        value = _mm_add_epi32(value, _mm_slli_si128(value, 4));
+        value = _mm_add_epi32(value, _mm_slli_si128(value, 8));
+        value = _mm_add_epi32(value, carry);
+        carry = _mm_shuffle_epi32(value, 0xFF);
+        return value;
+    }
+
+    // Byte i of every input row ends up in row BIT_REVERSED[i], four rounds of interleaving
+    // swap the bits of the row index around
+    const int BIT_REVERSED[16] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
+
+    void transpose16(__m128i rows[16])
+    {
+        __m128i a[16];
+        for (int i = 0; i < 8; i++)
+        {
+            a[i] = _mm_unpacklo_epi8(rows[i * 2], rows[i * 2 + 1]);
+            a[i + 8] = _mm_unpackhi_epi8(rows[i * 2], rows[i * 2 + 1]);
+        }
+        for (int i = 0; i < 8; i++)
+        {
+            rows[i] = _mm_unpacklo_epi16(a[i * 2], a[i * 2 + 1]);
+            rows[i + 8] = _mm_unpackhi_epi16(a[i * 2], a[i * 2 + 1]);
+        }
+        for (int i = 0; i < 8; i++)
+        {
+            a[i] = _mm_unpacklo_epi32(rows[i * 2], rows[i * 2 + 1]);
+            a[i + 8] = _mm_unpackhi_epi32(rows[i * 2], rows[i * 2 + 1]);
+        }
+        for (int i = 0; i < 8; i++)
+        {
+            rows[i] = _mm_unpacklo_epi64(a[i * 2], a[i * 2 + 1]);
+            rows[i + 8] = _mm_unpackhi_epi64(a[i * 2], a[i * 2 + 1]);
+        }
+    }
+#endif
+}
+
+std::vector<unsigned char> MeshCodec::encodeVertices(const PackedVertex* vertices, std::size_t count)
+{
+    const std::size_t stride = sizeof(PackedVertex);
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(vertices);
+
+    // Every block starts from a zero vertex, so blocks decode independently
+    std::vector<unsigned char> filtered(count * stride);
+    for (std::size_t i = 0; i < count; i++)
+        for (std::size_t b = 0; b < stride; b++)
+            filtered[i * stride + b] = zigzag8(bytes[i * stride + b], i % BLOCK_ELEMENTS ? bytes[(i - 1) * stride + b] : 0);
+
+    return encodeStream(filtered.data(), count, stride);
+}
+
+std::vector<unsigned char> MeshCodec::encodeIndices(const std::uint32_t* indices, std::size_t count)
+{
+    // Little endian, so the low byte of each difference goes into the first plane
+    std::vector<unsigned char> filtered(count * sizeof(std::uint32_t));
+    for (std::size_t i = 0; i < count; i++)
+    {
+        std::uint32_t value = zigzag32(indices[i], i % BLOCK_ELEMENTS ? indices[i - 1] : 0);
+        std::memcpy(&filtered[i * sizeof(std::uint32_t)], &value, sizeof(value));
+    }
+
+    return encodeStream(filtered.data(), count, sizeof(std::uint32_t));
+}
+
+bool MeshCodec::validVertices(const unsigned char* stream, std::size_t size, std::size_t count)
+{
+    return validStream(stream, size, count, sizeof(PackedVertex));
+}
+
+bool MeshCodec::validIndices(const unsigned char* stream, std::size_t size, std::size_t count)
+{
+    return validStream(stream, size, count, sizeof(std::uint32_t));
+}
+
+std::uint32_t MeshCodec::blockCount(const unsigned char* stream)
+{
+    StreamHeader header;
+    std::memcpy(&header, stream, sizeof(header));
+    return header.blocks;
+}
+
+bool MeshCodec::decodeVertices(PackedVertex* vertices, const unsigned char* stream, std::uint32_t firstBlock, std::uint32_t lastBlock)
+{
+    const std::size_t stride = sizeof(PackedVertex);
+    static_assert(sizeof(PackedVertex) <= MAX_STRIDE, "the decoder transposes at most 16 planes");
+
+    alignas(16) unsigned char planes[MAX_STRIDE * BLOCK_ELEMENTS];
+    for (std::uint32_t block = firstBlock; block < lastBlock; block++)
+    {
+        std::size_t elements = unpackBlock(stream, block, planes);
+        if (!elements)
+            return false;
+
+        unsigned char* out = reinterpret_cast<unsigned char*>(vertices + std::size_t(block) * BLOCK_ELEMENTS);
+
+#ifdef MESH_CODEC_SSE
+        std::size_t groups = (elements + GROUP_SIZE - 1) / GROUP_SIZE;
+        __m128i carry[MAX_STRIDE];
+        for (std::size_t plane = 0; plane < stride; plane++)
+            carry[plane] = _mm_setzero_si128();
+
+        for (std::size_t g = 0; g < groups; g++)
+        {
+            __m128i rows[16];
+            for (std::size_t plane = 0; plane < stride; plane++)
+            {
+                __m128i delta = _mm_load_si128(reinterpret_cast<const __m128i*>(planes + plane * BLOCK_ELEMENTS + g * GROUP_SIZE));
+                rows[plane] = prefix8(unzigzag8(delta), carry[plane]);
+            }
+            for (std::size_t plane = stride; plane < 16; plane++)
+                rows[plane] = _mm_setzero_si128();
+
+            transpose16(rows);
+
+            // Each full store spills into the next vertex, which is written right after. The last one
+            // takes two stores, the vertex behind it may belong to another thread's block
+            std::size_t count = std::min(GROUP_SIZE, elements - g * GROUP_SIZE);
+            unsigned char* target = out + g * GROUP_SIZE * stride;
+            for (std::size_t i = 0; i + 1 < count; i++)
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i * stride), rows[BIT_REVERSED[i]]);
+
+            __m128i last = rows[BIT_REVERSED[count - 1]];
+            int tail = _mm_cvtsi128_si32(_mm_srli_si128(last, 8));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(target + (count - 1) * stride), last);
+            std::memcpy(target + (count - 1) * stride + 8, &tail, sizeof(tail));
+        }
+#else
+        for (std::size_t plane = 0; plane < stride; plane++)
+        {
+            unsigned char previous = 0;
+            for (std::size_t i = 0; i < elements; i++)
+            {
+                unsigned char value = planes[plane * BLOCK_ELEMENTS + i];
+                previous = std::uint8_t(previous + ((value >> 1) ^ (0u - (value & 1u))));
+                out[i * stride + plane] = previous;
+            }
+        }
+#endif
+    }
+
+    return true;
+}
+
+bool MeshCodec::decodeIndices(std::uint32_t* indices, std::uint32_t vertexCount, const unsigned char* stream,
+                              std::uint32_t firstBlock, std::uint32_t lastBlock)
+{
+    alignas(16) unsigned char planes[4 * BLOCK_ELEMENTS];
+    for (std::uint32_t block = firstBlock; block < lastBlock; block++)
+    {
+        std::size_t elements = unpackBlock(stream, block, planes);
+        if (!elements || !vertexCount)
+            return false;
+
+        std::uint32_t* out = indices + std::size_t(block) * BLOCK_ELEMENTS;
+
+#ifdef MESH_CODEC_SSE
+        std::size_t groups = (elements + GROUP_SIZE - 1) / GROUP_SIZE;
+        // Unsigned compare through the signed one, both sides moved down by 2^31
+        const __m128i bias = _mm_set1_epi32(int(0x80000000u));
+        const __m128i limit = _mm_set1_epi32(int((vertexCount - 1) ^ 0x80000000u));
+        __m128i outOfRange = _mm_setzero_si128();
+        __m128i carry = _mm_setzero_si128();
+
+        for (std::size_t g = 0; g < groups; g++)
+        {
+            const unsigned char* group = planes + g * GROUP_SIZE;
+            __m128i b0 = _mm_load_si128(reinterpret_cast<const __m128i*>(group));
+            __m128i b1 = _mm_load_si128(reinterpret_cast<const __m128i*>(group + BLOCK_ELEMENTS));
+            __m128i b2 = _mm_load_si128(reinterpret_cast<const __m128i*>(group + BLOCK_ELEMENTS * 2));
+            __m128i b3 = _mm_load_si128(reinterpret_cast<const __m128i*>(group + BLOCK_ELEMENTS * 3));
+
+            __m128i low01 = _mm_unpacklo_epi8(b0, b1), high01 = _mm_unpackhi_epi8(b0, b1);
+            __m128i low23 = _mm_unpacklo_epi8(b2, b3), high23 = _mm_unpackhi_epi8(b2, b3);
+
+            __m128i values[4] = {
+                _mm_unpacklo_epi16(low01, low23), _mm_unpackhi_epi16(low01, low23),
+                _mm_unpacklo_epi16(high01, high23), _mm_unpackhi_epi16(high01, high23)
+            };
+
+            std::size_t count = std::min(GROUP_SIZE, elements - g * GROUP_SIZE);
+            for (int i = 0; i < 4; i++)
+            {
+                values[i] = prefix32(unzigzag32(values[i]), carry);
+                outOfRange = _mm_or_si128(outOfRange, _mm_cmpgt_epi32(_mm_xor_si128(values[i], bias), limit));
+            }
+
+            if (count == GROUP_SIZE)
+            {
+                for (int i = 0; i < 4; i++)
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + g * GROUP_SIZE + i * 4), values[i]);
+            }
+            else
+            {
+                alignas(16) std::uint32_t tail[GROUP_SIZE];
+                for (int i = 0; i < 4; i++)
+                    _mm_store_si128(reinterpret_cast<__m128i*>(tail + i * 4), values[i]);
+                std::memcpy(out + g * GROUP_SIZE, tail, count * sizeof(std::uint32_t));
+            }
+        }
+
+        // Padding repeats the last index, so it never fails a good block
+        if (_mm_movemask_epi8(outOfRange))
+            return false;
+#else
+        std::uint32_t previous = 0;
+        for (std::size_t i = 0; i < elements; i++)
+        {
+            std::uint32_t value = std::uint32_t(planes[i]) | std::uint32_t(planes[BLOCK_ELEMENTS + i]) << 8 |
+                                  std::uint32_t(planes[BLOCK_ELEMENTS * 2 + i]) << 16 | std::uint32_t(planes[BLOCK_ELEMENTS * 3 + i]) << 24;
+            previous += (value >> 1) ^ (0u - (value & 1u));
+            if (previous >= vertexCount)
+                return false;
+            out[i] = previous;
+        }
+#endif
+    }
+
+    return true;
+}
+
+MeshDecoder::MeshDecoder(int threads)
+{
+    if (threads < 0)
+        threads = std::max(0, int(std::thread::hardware_concurrency()) - 1);
+
+    for (int i = 0; i < threads; i++)
+        workers.emplace_back(&MeshDecoder::workerLoop, this);
+}
+
+MeshDecoder::~MeshDecoder()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+bool MeshDecoder::decode(const MeshFile& file, PackedVertex* vertices, std::uint32_t* indices)
+{
+    const MeshFileHeader& header = file.header();
+    std::size_t decodedBytes = header.vertexCount * sizeof(PackedVertex) + header.indexCount * sizeof(std::uint32_t);
+
+    if (!file.compressed())
+    {
+        std::memcpy(vertices, file.vertices(), header.vertexCount * sizeof(PackedVertex));
+        std::memcpy(indices, file.indices(), header.indexCount * sizeof(std::uint32_t));
+        return true;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        failed = false;
+
+        std::uint32_t vertexBlocks = MeshCodec::blockCount(file.vertexStream());
+        for (std::uint32_t block = 0; block < vertexBlocks; block += JOB_BLOCKS)
+            jobs.push_back(Job{ file.vertexStream(), vertices, nullptr, 0, block, std::min(vertexBlocks, block + JOB_BLOCKS) });
+
+        std::uint32_t indexBlocks = MeshCodec::blockCount(file.indexStream());
+        for (std::uint32_t block = 0; block < indexBlocks; block += JOB_BLOCKS)
+            jobs.push_back(Job{ file.indexStream(), nullptr, indices, header.vertexCount, block, std::min(indexBlocks, block + JOB_BLOCKS) });
+    }
+    wake.notify_all();
+
+    // Helps out until the queue is empty, then waits for the jobs still running elsewhere
+    bool ok;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!jobs.empty())
+        {
+            Job job = jobs.front();
+            jobs.pop_front();
+            running++;
+
+            lock.unlock();
+            bool decoded = run(job);
+            lock.lock();
+
+            running--;
+            failed = failed || !decoded;
+        }
+        finished.wait(lock, [this]() { return running == 0; });
+        ok = !failed;
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    if (!ok)
+    {
+        std::cout << "ERROR::MESH_CODEC::CORRUPT " << file.path() << std::endl;
+        return false;
+    }
+
+    std::size_t compressedBytes = file.vertexBytes() + file.indexBytes();
+    stats.meshes++;
+    stats.compressedBytes += compressedBytes;
+    stats.decodedBytes += decodedBytes;
+    stats.milliseconds += elapsed.count();
+
+    std::cout << "MESH_CODEC::DECODED " << file.path() << ": " << compressedBytes << " -> " << decodedBytes << " bytes, ratio "
+              << double(decodedBytes) / double(compressedBytes) << ", " << elapsed.count() << " ms, "
+              << double(decodedBytes) / (elapsed.count() * 1.0e6) << " GB/s on " << workers.size() + 1 << " threads" << std::endl;
+    return true;
+}
+
+void MeshDecoder::workerLoop()
+{
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+            job = jobs.front();
+            jobs.pop_front();
+            running++;
+        }
+
+        bool decoded = run(job);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running--;
+            failed = failed || !decoded;
+        }
+        finished.notify_all();
+    }
+}
+
+bool MeshDecoder::run(const Job& job)
+{
+    if (job.vertices)
+        return MeshCodec::decodeVertices(job.vertices, job.stream, job.firstBlock, job.lastBlock);
+    return MeshCodec::decodeIndices(job.indices, job.vertexCount, job.stream, job.firstBlock, job.lastBlock);
+}
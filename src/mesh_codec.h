@@ -0,0 +1,94 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class MeshFile;
+
+// Lossless compression of the vertex and index streams of a .pmesh file. A stream is cut into
+// blocks of BLOCK_ELEMENTS elements that decode on their own, so one mesh spreads over any number
+// of threads. Inside a block every byte of the element is stored as its own plane: vertex bytes as
+// the zigzagged difference to the same byte of the previous vertex, indices as the zigzagged
+// difference to the previous index. Each plane is split into groups of 16 bytes stored with 0, 2,
+// 4 or 8 bits each, whichever is the smallest that holds the whole group, picked by a 2 bit header.
+// Decoding is a handful of SSE2 unpacks and prefix sums per group
+namespace MeshCodec
+{
+    const std::uint32_t BLOCK_ELEMENTS = 256;
+
+    std::vector<unsigned char> encodeVertices(const PackedVertex* vertices, std::size_t count);
+    std::vector<unsigned char> encodeIndices(const std::uint32_t* indices, std::size_t count);
+
+    // Checks the stream header and block table against the expected element count, the block
+    // contents are only checked while decoding
+    bool validVertices(const unsigned char* stream, std::size_t size, std::size_t count);
+    bool validIndices(const unsigned char* stream, std::size_t size, std::size_t count);
+
+    std::uint32_t blockCount(const unsigned char* stream);
+
+    // Decodes blocks [firstBlock, lastBlock) of a valid stream into their place in the full array.
+    // The destination is only written, never read, so it can be mapped buffer memory. False when a
+    // block is corrupt or, for indices, references a vertex at or past vertexCount
+    bool decodeVertices(PackedVertex* vertices, const unsigned char* stream, std::uint32_t firstBlock, std::uint32_t lastBlock);
+    bool decodeIndices(std::uint32_t* indices, std::uint32_t vertexCount, const unsigned char* stream, std::uint32_t firstBlock, std::uint32_t lastBlock);
+}
+
+// Decodes compressed mesh files on worker threads. The calling thread takes jobs as well while it
+// waits, so a decoder without workers still works, just on one core
+class MeshDecoder
+{
+public:
+    // Totals over every mesh decoded so far
+    struct Stats
+    {
+        unsigned int meshes = 0;
+        std::size_t compressedBytes = 0;
+        std::size_t decodedBytes = 0;
+        double milliseconds = 0.0;
+    };
+
+    Stats stats;
+
+    // Negative means one less than the number of cores
+    explicit MeshDecoder(int threads = -1);
+    ~MeshDecoder();
+
+    MeshDecoder(const MeshDecoder&) = delete;
+    MeshDecoder& operator=(const MeshDecoder&) = delete;
+
+    // Blocks until the whole mesh is decoded and prints its compression ratio and decode speed.
+    // Room for header().vertexCount vertices and header().indexCount indices is expected
+    bool decode(const MeshFile& file, PackedVertex* vertices, std::uint32_t* indices);
+
+private:
+    // A run of blocks of one stream
+    struct Job
+    {
+        const unsigned char* stream;
+        PackedVertex* vertices;
+        std::uint32_t* indices;
+        std::uint32_t vertexCount;
+        std::uint32_t firstBlock;
+        std::uint32_t lastBlock;
+    };
+
+    void workerLoop();
+    bool run(const Job& job);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    std::deque<Job> jobs;
+    unsigned int running = 0;
+    bool failed = false;
+    bool stopping = false;
+};
@@ -0,0 +1,266 @@
+#include "mesh_file.h"
+
+#include "mesh_codec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    std::uint64_t alignOffset(std::uint64_t offset)
+    {
+        return (offset + 15) & ~std::uint64_t(15);
+    }
+
+    // Written so that nothing can wrap around, whatever a hostile header holds
+    bool fits(std::uint64_t offset, std::uint64_t bytes, std::uint64_t size)
+    {
+        return offset <= size && bytes <= size - offset;
+    }
+}
+
+MeshFile::MeshFile(const std::string& path)
+    : filePath(path)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+#ifdef __unix__
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cout << "ERROR::MESH_FILE::NOT_FOUND " << path << std::endl;
+        return;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        void* view = mmap(nullptr, (std::size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED)
+        {
+            // The upload reads every stream front to back right away. Advice values are not flags,
+            // each one needs its own call
+            madvise(view, (std::size_t)info.st_size, MADV_SEQUENTIAL);
+            madvise(view, (std::size_t)info.st_size, MADV_WILLNEED);
+            data = static_cast<const unsigned char*>(view);
+            size = (std::size_t)info.st_size;
+            mapped = true;
+        }
+    }
+    close(fd);
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (file)
+    {
+        fallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data = fallback.empty() ? nullptr : fallback.data();
+        size = fallback.size();
+    }
+#endif
+
+    if (!data)
+    {
+        std::cout << "ERROR::MESH_FILE::NOT_READ " << path << std::endl;
+        return;
+    }
+
+    if (!validate(path))
+    {
+#ifdef __unix__
+        munmap(const_cast<unsigned char*>(data), size);
+#endif
+        data = nullptr;
+        size = 0;
+        mapped = false;
+        return;
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "MESH_FILE::OPENED " << path << ": " << header().vertexCount << " vertices, " << lods()[0].indexCount / 3 << " triangles, "
+              << header().submeshCount << " submeshes, " << lods().size() << " levels" << (compressed() ? ", compressed" : "")
+              << " in " << elapsed.count() << " ms" << std::endl;
+}
+
+MeshFile::~MeshFile()
+{
+#ifdef __unix__
+    if (mapped)
+        munmap(const_cast<unsigned char*>(data), size);
+#endif
+}
+
+// Everything the pointers above rely on, checked once so the renderer never has to
+bool MeshFile::validate(const std::string& path) const
+{
+    if (size < sizeof(MeshFileHeader))
+    {
+        std::cout << "ERROR::MESH_FILE::TRUNCATED " << path << std::endl;
+        return false;
+    }
+
+    const MeshFileHeader& h = header();
+    if (std::memcmp(h.magic, "PMSH", 4) != 0 || h.version < 1 || h.version > MESH_FILE_VERSION || h.vertexStride != sizeof(PackedVertex))
+    {
+        std::cout << "ERROR::MESH_FILE::UNSUPPORTED " << path << std::endl;
+        return false;
+    }
+
+    // Compressed streams are only as long as the gap to the next one, which therefore has to follow them.
+    // The counts are 32 bit, so the byte sizes cannot overflow, only the offsets added to them could
+    bool packed = (h.flags & MESH_FILE_COMPRESSED) != 0;
+    bool ordered = !packed || (h.vertexOffset <= h.indexOffset && h.indexOffset <= h.submeshOffset);
+    std::uint64_t vertexSize = packed ? h.indexOffset - h.vertexOffset : std::uint64_t(h.vertexCount) * sizeof(PackedVertex);
+    std::uint64_t indexSize = packed ? h.submeshOffset - h.indexOffset : std::uint64_t(h.indexCount) * sizeof(std::uint32_t);
+    if (h.fileSize != size || !ordered || !fits(h.vertexOffset, vertexSize, size) || !fits(h.indexOffset, indexSize, size) ||
+        !fits(h.submeshOffset, std::uint64_t(h.submeshCount) * sizeof(Submesh), size) ||
+        !fits(h.lodOffset, std::uint64_t(h.lodCount) * sizeof(MeshLod), size) ||
+        (h.vertexOffset | h.indexOffset | h.submeshOffset | h.lodOffset) % 16 != 0)
+    {
+        std::cout << "ERROR::MESH_FILE::TRUNCATED " << path << std::endl;
+        return false;
+    }
+
+    if (packed)
+    {
+        // The block contents and index ranges are checked by the decoder as it goes
+        if (!MeshCodec::validVertices(vertexStream(), vertexBytes(), h.vertexCount) || !MeshCodec::validIndices(indexStream(), indexBytes(), h.indexCount))
+        {
+            std::cout << "ERROR::MESH_FILE::BAD_STREAM " << path << std::endl;
+            return false;
+        }
+    }
+    else
+    {
+        for (std::uint32_t i = 0; i < h.indexCount; i++)
+        {
+            if (indices()[i] >= h.vertexCount)
+            {
+                std::cout << "ERROR::MESH_FILE::INDEX_OUT_OF_RANGE " << path << std::endl;
+                return false;
+            }
+        }
+    }
+
+    for (std::uint32_t i = 0; i < h.submeshCount; i++)
+    {
+        const Submesh& submesh = submeshes()[i];
+        if (std::uint64_t(submesh.firstIndex) + submesh.indexCount > h.indexCount)
+        {
+            std::cout << "ERROR::MESH_FILE::SUBMESH_OUT_OF_RANGE " << path << std::endl;
+            return false;
+        }
+    }
+
+    const MeshLod* levels = reinterpret_cast<const MeshLod*>(data + h.lodOffset);
+    for (std::uint32_t i = 0; i < h.lodCount; i++)
+    {
+        if (std::uint64_t(levels[i].firstIndex) + levels[i].indexCount > h.indexCount || (i == 0 && levels[i].firstIndex != 0))
+        {
+            std::cout << "ERROR::MESH_FILE::LOD_OUT_OF_RANGE " << path << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::vector<MeshLod> MeshFile::lods() const
+{
+    const MeshFileHeader& h = header();
+    if (!h.lodCount)
+        return std::vector<MeshLod>(1, MeshLod{ 0, h.indexCount, 0.0f, 0 });
+
+    const MeshLod* levels = reinterpret_cast<const MeshLod*>(data + h.lodOffset);
+    return std::vector<MeshLod>(levels, levels + h.lodCount);
+}
+
+bool MeshFile::write(const std::string& path, const PackedMesh& mesh, bool compress)
+{
+    const unsigned char* vertexData = reinterpret_cast<const unsigned char*>(mesh.vertices.data());
+    const unsigned char* indexData = reinterpret_cast<const unsigned char*>(mesh.indices.data());
+    std::size_t vertexBytes = mesh.vertices.size() * sizeof(PackedVertex);
+    std::size_t indexBytes = mesh.indices.size() * sizeof(std::uint32_t);
+
+    std::vector<unsigned char> vertexStream, indexStream;
+    if (compress)
+    {
+        vertexStream = MeshCodec::encodeVertices(mesh.vertices.data(), mesh.vertices.size());
+        indexStream = MeshCodec::encodeIndices(mesh.indices.data(), mesh.indices.size());
+
+        std::cout << "MESH_CODEC::ENCODED " << path << ": vertices " << vertexBytes << " -> " << vertexStream.size()
+                  << " bytes, indices " << indexBytes << " -> " << indexStream.size() << " bytes, ratio "
+                  << double(vertexBytes + indexBytes) / double(vertexStream.size() + indexStream.size()) << std::endl;
+
+        vertexData = vertexStream.data();
+        indexData = indexStream.data();
+        vertexBytes = vertexStream.size();
+        indexBytes = indexStream.size();
+    }
+
+    // Value initialized, so every reserved and padding field is zero
+    MeshFileHeader header = MeshFileHeader();
+    std::memcpy(header.magic, "PMSH", 4);
+    header.version = MESH_FILE_VERSION;
+    header.flags = (mesh.halfTexCoords ? MESH_FILE_HALF_TEXCOORDS : 0) | (compress ? MESH_FILE_COMPRESSED : 0);
+    header.vertexStride = sizeof(PackedVertex);
+    header.vertexCount = std::uint32_t(mesh.vertices.size());
+    header.indexCount = std::uint32_t(mesh.indices.size());
+    header.submeshCount = std::uint32_t(mesh.submeshes.size());
+    header.lodCount = std::uint32_t(mesh.lods.size());
+
+    header.vertexOffset = alignOffset(sizeof(MeshFileHeader));
+    header.indexOffset = alignOffset(header.vertexOffset + vertexBytes);
+    header.submeshOffset = alignOffset(header.indexOffset + indexBytes);
+    header.lodOffset = alignOffset(header.submeshOffset + mesh.submeshes.size() * sizeof(Submesh));
+    header.fileSize = header.lodOffset + mesh.lods.size() * sizeof(MeshLod);
+
+    for (int i = 0; i < 16; i++)
+        header.decode[i] = mesh.decode[i / 4][i % 4];
+
+    header.boundsMin = mesh.submeshes.empty() ? glm::vec3(0.0f) : mesh.submeshes[0].boundsMin;
+    header.boundsMax = mesh.submeshes.empty() ? glm::vec3(0.0f) : mesh.submeshes[0].boundsMax;
+    for (const Submesh& submesh : mesh.submeshes)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            header.boundsMin[axis] = std::min(header.boundsMin[axis], submesh.boundsMin[axis]);
+            header.boundsMax[axis] = std::max(header.boundsMax[axis], submesh.boundsMax[axis]);
+        }
+    }
+
+    std::vector<unsigned char> bytes((std::size_t)header.fileSize, 0);
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    if (vertexBytes)
+        std::memcpy(bytes.data() + header.vertexOffset, vertexData, vertexBytes);
+    if (indexBytes)
+        std::memcpy(bytes.data() + header.indexOffset, indexData, indexBytes);
+    if (!mesh.submeshes.empty())
+        std::memcpy(bytes.data() + header.submeshOffset, mesh.submeshes.data(), mesh.submeshes.size() * sizeof(Submesh));
+    if (!mesh.lods.empty())
+        std::memcpy(bytes.data() + header.lodOffset, mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+
+    // Written next to the target and renamed, a crash never leaves half a mesh behind
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        if (!file)
+        {
+            std::cout << "ERROR::MESH_FILE::NOT_WRITTEN " << path << std::endl;
+            return false;
+        }
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Version 1 files have no level of detail stream and still load, as a single level. Version 3
+// added MESH_FILE_COMPRESSED
+const std::uint32_t MESH_FILE_VERSION = 3;
+const std::uint32_t MESH_FILE_HALF_TEXCOORDS = 1u << 0;
+const std::uint32_t MESH_FILE_COMPRESSED = 1u << 1;     // vertex and index streams go through MeshCodec
+
+// Start of a .pmesh file. Every stream follows at a 16 byte aligned offset in exactly the layout
+// the GPU and the renderer use, so loading is a map and one buffer upload per stream.
+// Little endian only, written by the mesh_convert tool. Compressed files keep the same layout, the
+// vertex and index streams are just smaller and have to be decoded, see MeshDecoder
+struct MeshFileHeader
+{
+    char magic[4];                  // "PMSH"
+    std::uint32_t version;
+    std::uint32_t flags;
+    std::uint32_t vertexStride;     // sizeof(PackedVertex)
+
+    std::uint32_t vertexCount;
+    std::uint32_t indexCount;
+    std::uint32_t submeshCount;
+    std::uint32_t lodCount;
+
+    std::uint64_t vertexOffset;     // PackedVertex[vertexCount]
+    std::uint64_t indexOffset;      // uint32_t[indexCount]
+    std::uint64_t submeshOffset;    // Submesh[submeshCount]
+    std::uint64_t fileSize;
+
+    float decode[16];               // column major, see PackedMesh::decode
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    std::uint64_t lodOffset;        // MeshLod[lodCount]
+};
+
+static_assert(sizeof(MeshFileHeader) == 160, "MeshFileHeader is stored as is");
+
+// Read only view of a .pmesh file. On POSIX systems the file is mmapped and the pointers point
+// straight into the page cache, elsewhere it is read into memory once
+class MeshFile
+{
+public:
+    explicit MeshFile(const std::string& path);
+    ~MeshFile();
+
+    MeshFile(const MeshFile&) = delete;
+    MeshFile& operator=(const MeshFile&) = delete;
+
+    // False when the file is missing, truncated or from another version
+    bool valid() const { return data != nullptr; }
+
+    const MeshFileHeader& header() const { return *reinterpret_cast<const MeshFileHeader*>(data); }
+    const std::string& path() const { return filePath; }
+
+    // Only for files without MESH_FILE_COMPRESSED
+    const PackedVertex* vertices() const { return reinterpret_cast<const PackedVertex*>(data + header().vertexOffset); }
+    const std::uint32_t* indices() const { return reinterpret_cast<const std::uint32_t*>(data + header().indexOffset); }
+
+    // The streams as stored, compressed or not. The sizes include the padding up to the next stream
+    bool compressed() const { return (header().flags & MESH_FILE_COMPRESSED) != 0; }
+    const unsigned char* vertexStream() const { return data + header().vertexOffset; }
+    const unsigned char* indexStream() const { return data + header().indexOffset; }
+    std::size_t vertexBytes() const { return std::size_t(header().indexOffset - header().vertexOffset); }
+    std::size_t indexBytes() const { return std::size_t(header().submeshOffset - header().indexOffset); }
+
+    const Submesh* submeshes() const { return reinterpret_cast<const Submesh*>(data + header().submeshOffset); }
+
+    // Never empty, files without levels get a single one over every index
+    std::vector<MeshLod> lods() const;
+
+    // Compressing prints the ratio of each stream
+    static bool write(const std::string& path, const PackedMesh& mesh, bool compress = false);
+
+private:
+    bool validate(const std::string& path) const;
+
+    std::string filePath;
+
+    const unsigned char* data = nullptr;
+    std::size_t size = 0;
+
+    bool mapped = false;
+    std::vector<unsigned char> fallback;
+};
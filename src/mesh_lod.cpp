@@ -0,0 +1,341 @@
+#include "mesh_lod.h"
+#include "meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+namespace
+{
+    // Symmetric 4x4 matrix of the summed squared plane distances, upper triangle only
+    struct Quadric
+    {
+        double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+    };
+
+    void addPlane(Quadric& q, const glm::vec3& normal, float d)
+    {
+        double a = normal.x, b = normal.y, c = normal.z, w = d;
+        q.xx += a * a; q.xy += a * b; q.xz += a * c; q.xw += a * w;
+        q.yy += b * b; q.yz += b * c; q.yw += b * w;
+        q.zz += c * c; q.zw += c * w;
+        q.ww += w * w;
+    }
+
+    void addQuadric(Quadric& q, const Quadric& other)
+    {
+        q.xx += other.xx; q.xy += other.xy; q.xz += other.xz; q.xw += other.xw;
+        q.yy += other.yy; q.yz += other.yz; q.yw += other.yw;
+        q.zz += other.zz; q.zw += other.zw;
+        q.ww += other.ww;
+    }
+
+    double evaluate(const Quadric& a, const Quadric& b, const glm::vec3& p)
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double xx = a.xx + b.xx, xy = a.xy + b.xy, xz = a.xz + b.xz, xw = a.xw + b.xw;
+        double yy = a.yy + b.yy, yz = a.yz + b.yz, yw = a.yw + b.yw;
+        double zz = a.zz + b.zz, zw = a.zw + b.zw, ww = a.ww + b.ww;
+        double result = x * x * xx + y * y * yy + z * z * zz + 2.0 * (x * y * xy + x * z * xz + y * z * yz) +
+                        2.0 * (x * xw + y * yw + z * zw) + ww;
+        return result > 0.0 ? result : 0.0;
+    }
+
+    struct PositionHash
+    {
+        std::size_t operator()(const glm::vec3& position) const
+        {
+            std::uint32_t bits[3];
+            std::memcpy(bits, &position, sizeof(bits));
+            return std::size_t(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+        }
+    };
+
+    struct PositionEqual
+    {
+        bool operator()(const glm::vec3& a, const glm::vec3& b) const { return std::memcmp(&a, &b, sizeof(glm::vec3)) == 0; }
+    };
+
+    struct Collapse
+    {
+        double cost;
+        std::uint32_t from;
+        std::uint32_t to;
+
+        bool operator<(const Collapse& other) const { return cost < other.cost; }
+    };
+
+    glm::vec3 triangleNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+    {
+        return glm::cross(b - a, c - a);
+    }
+}
+
+std::vector<std::uint32_t> MeshBuilder::simplify(const MeshData& mesh, std::uint32_t firstIndex, std::uint32_t indexCount,
+                                                 std::size_t targetIndexCount, float* error)
+{
+    const std::uint32_t unused = 0xFFFFFFFFu;
+    const std::size_t vertexCount = mesh.vertices.size();
+    std::vector<std::uint32_t> indices(mesh.indices.begin() + firstIndex, mesh.indices.begin() + firstIndex + indexCount / 3 * 3);
+    if (error)
+        *error = 0.0f;
+
+    // Vertices that only differ in normal or texture coordinate share one position and one quadric
+    std::unordered_map<glm::vec3, std::uint32_t, PositionHash, PositionEqual> positionIds;
+    std::vector<std::uint32_t> positionOf(vertexCount, unused);
+    std::vector<std::uint32_t> firstVertexAt;
+    for (std::uint32_t index : indices)
+    {
+        if (positionOf[index] != unused)
+            continue;
+
+        auto inserted = positionIds.emplace(mesh.vertices[index].position, std::uint32_t(firstVertexAt.size()));
+        if (inserted.second)
+            firstVertexAt.push_back(index);
+        positionOf[index] = inserted.first->second;
+    }
+
+    // A position with more than one vertex lies on a seam, moving it would tear the attributes apart
+    std::vector<bool> locked(firstVertexAt.size(), false);
+    for (std::size_t v = 0; v < vertexCount; v++)
+        if (positionOf[v] != unused && firstVertexAt[positionOf[v]] != v)
+            locked[positionOf[v]] = true;
+
+    // Edges used by a single triangle are open borders, more than two is non manifold. Both stay put
+    std::unordered_map<std::uint64_t, int> edgeUse;
+    for (std::size_t i = 0; i < indices.size(); i += 3)
+    {
+        for (int corner = 0; corner < 3; corner++)
+        {
+            std::uint64_t a = positionOf[indices[i + corner]];
+            std::uint64_t b = positionOf[indices[i + (corner + 1) % 3]];
+            edgeUse[a < b ? (a << 32 | b) : (b << 32 | a)]++;
+        }
+    }
+    for (const auto& edge : edgeUse)
+    {
+        if (edge.second != 2)
+        {
+            locked[std::uint32_t(edge.first >> 32)] = true;
+            locked[std::uint32_t(edge.first & 0xFFFFFFFFu)] = true;
+        }
+    }
+
+    std::vector<Quadric> quadrics(firstVertexAt.size(), Quadric());
+    for (std::size_t i = 0; i < indices.size(); i += 3)
+    {
+        const glm::vec3& a = mesh.vertices[indices[i + 0]].position;
+        glm::vec3 normal = triangleNormal(a, mesh.vertices[indices[i + 1]].position, mesh.vertices[indices[i + 2]].position);
+        float length = std::sqrt(glm::dot(normal, normal));
+        if (length <= 0.0f)
+            continue;
+
+        normal = normal / length;
+        Quadric plane = Quadric();
+        addPlane(plane, normal, -glm::dot(normal, a));
+        for (int corner = 0; corner < 3; corner++)
+            addQuadric(quadrics[positionOf[indices[i + corner]]], plane);
+    }
+
+    double maxCost = 0.0;
+    std::vector<std::uint32_t> offsets;
+    std::vector<std::uint32_t> triangles;
+    std::vector<Collapse> collapses;
+    std::vector<bool> dirty;
+
+    while (indices.size() > targetIndexCount)
+    {
+        // Triangles around every vertex, rebuilt each pass since collapses rewrite the index buffer
+        offsets.assign(vertexCount + 1, 0);
+        for (std::uint32_t index : indices)
+            offsets[index + 1]++;
+        for (std::size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] += offsets[v];
+        triangles.resize(indices.size());
+        std::vector<std::uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (std::size_t i = 0; i < indices.size(); i++)
+            triangles[fill[indices[i]]++] = std::uint32_t(i / 3);
+
+        // Cheapest edge out of every movable vertex, the vertex lands on the other end
+        collapses.clear();
+        std::vector<double> bestCost(vertexCount, -1.0);
+        std::vector<std::uint32_t> bestTarget(vertexCount, unused);
+        for (std::size_t i = 0; i < indices.size(); i += 3)
+        {
+            for (int corner = 0; corner < 3; corner++)
+            {
+                for (int other = 1; other < 3; other++)
+                {
+                    std::uint32_t from = indices[i + corner];
+                    std::uint32_t to = indices[i + (corner + other) % 3];
+                    if (locked[positionOf[from]] || positionOf[from] == positionOf[to])
+                        continue;
+
+                    double cost = evaluate(quadrics[positionOf[from]], quadrics[positionOf[to]], mesh.vertices[to].position);
+                    if (bestTarget[from] == unused || cost < bestCost[from])
+                    {
+                        bestCost[from] = cost;
+                        bestTarget[from] = to;
+                    }
+                }
+            }
+        }
+        for (std::uint32_t v = 0; v < vertexCount; v++)
+            if (bestTarget[v] != unused)
+                collapses.push_back(Collapse{ bestCost[v], v, bestTarget[v] });
+
+        std::sort(collapses.begin(), collapses.end());
+
+        // Every collapse removes about two triangles, only as many as the target still asks for
+        std::size_t trianglesLeft = (indices.size() - targetIndexCount) / 3;
+        std::size_t removed = 0;
+        std::vector<std::uint32_t> remap(vertexCount);
+        for (std::uint32_t v = 0; v < vertexCount; v++)
+            remap[v] = v;
+        dirty.assign(firstVertexAt.size(), false);
+
+        for (const Collapse& collapse : collapses)
+        {
+            if (removed >= trianglesLeft)
+                break;
+            if (dirty[positionOf[collapse.from]] || dirty[positionOf[collapse.to]])
+                continue;
+
+            // Rejected when a triangle that survives the collapse would flip over
+            const glm::vec3& target = mesh.vertices[collapse.to].position;
+            bool flips = false;
+            std::size_t collapsing = 0;
+            for (std::uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1] && !flips; a++)
+            {
+                const std::uint32_t* triangle = &indices[triangles[a] * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to ||
+                    positionOf[triangle[0]] == positionOf[collapse.to] || positionOf[triangle[1]] == positionOf[collapse.to] ||
+                    positionOf[triangle[2]] == positionOf[collapse.to])
+                {
+                    collapsing++;
+                    continue;
+                }
+
+                glm::vec3 before[3], after[3];
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    before[corner] = mesh.vertices[triangle[corner]].position;
+                    after[corner] = triangle[corner] == collapse.from ? target : before[corner];
+                }
+                flips = glm::dot(triangleNormal(before[0], before[1], before[2]), triangleNormal(after[0], after[1], after[2])) <= 0.0f;
+            }
+            if (flips || !collapsing)
+                continue;
+
+            remap[collapse.from] = collapse.to;
+            removed += collapsing;
+            maxCost = std::max(maxCost, collapse.cost);
+            addQuadric(quadrics[positionOf[collapse.to]], quadrics[positionOf[collapse.from]]);
+
+            // The whole one ring changes shape, nothing around it moves again in this pass
+            for (std::uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1]; a++)
+                for (int corner = 0; corner < 3; corner++)
+                    dirty[positionOf[indices[triangles[a] * 3 + corner]]] = true;
+        }
+
+        if (!removed)
+            break;
+
+        std::size_t write = 0;
+        for (std::size_t i = 0; i < indices.size(); i += 3)
+        {
+            std::uint32_t a = remap[indices[i + 0]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+            if (positionOf[a] == positionOf[b] || positionOf[b] == positionOf[c] || positionOf[a] == positionOf[c])
+                continue;
+
+            indices[write++] = a;
+            indices[write++] = b;
+            indices[write++] = c;
+        }
+        indices.resize(write);
+    }
+
+    if (error)
+        *error = float(std::sqrt(maxCost));
+    return indices;
+}
+
+void MeshBuilder::buildLods(MeshData& mesh, const std::string& name, int maxLods, float ratio)
+{
+    mesh.lods.clear();
+    mesh.lods.push_back(MeshLod{ 0, std::uint32_t(mesh.indices.size()), 0.0f, 0 });
+
+    std::string chain = std::to_string(mesh.indices.size() / 3);
+    for (int level = 1; level < maxLods; level++)
+    {
+        const MeshLod previous = mesh.lods.back();
+        std::size_t target = std::size_t(previous.indexCount / 3 * ratio) * 3;
+
+        float error = 0.0f;
+        std::vector<std::uint32_t> indices = simplify(mesh, previous.firstIndex, previous.indexCount, target, &error);
+
+        // Not worth a level of its own, locked borders and seams keep most of the mesh
+        if (indices.empty() || indices.size() > previous.indexCount * 9 / 10)
+            break;
+
+        // Same ordering as level 0, the vertices are only borrowed for the duration
+        MeshData reordered;
+        reordered.vertices.swap(mesh.vertices);
+        reordered.indices.swap(indices);
+        optimizeMeshlets(reordered);
+        mesh.vertices.swap(reordered.vertices);
+
+        // Each level was simplified from the one before, so the deviations add up
+        MeshLod lod = { std::uint32_t(mesh.indices.size()), std::uint32_t(reordered.indices.size()), previous.error + error, 0 };
+        mesh.indices.insert(mesh.indices.end(), reordered.indices.begin(), reordered.indices.end());
+        mesh.lods.push_back(lod);
+
+        chain += " -> " + std::to_string(lod.indexCount / 3) + " (error " + std::to_string(lod.error) + ")";
+    }
+
+    std::cout << "MESH::LODS " << name << ": " << chain << " triangles" << std::endl;
+}
+
+float LodSelector::projectionScale(float fovY, float viewportHeight)
+{
+    return viewportHeight / (2.0f * std::tan(fovY * 0.5f));
+}
+
+int LodSelector::select(unsigned int object, const std::vector<MeshLod>& lods, const glm::vec3& center, float radius,
+                        const glm::mat4& model, const glm::vec3& cameraPos, float projectionScale)
+{
+    if (object >= current.size())
+        current.resize(object + 1, 0);
+
+    int& level = current[object];
+    int previous = level;
+    level = std::min(level, int(lods.size()) - 1);
+    if (level < 0)
+        level = 0;
+
+    float scale = std::sqrt(std::max(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+                                     std::max(glm::dot(glm::vec3(model[1]), glm::vec3(model[1])), glm::dot(glm::vec3(model[2]), glm::vec3(model[2])))));
+
+    // Distance to the closest point of the bounds, inside them everything is full detail
+    glm::vec3 offset = glm::vec3(model * glm::vec4(center, 1.0f)) - cameraPos;
+    float distance = std::max(std::sqrt(glm::dot(offset, offset)) - radius * scale, 1e-3f);
+    float pixelsPerUnit = scale * projectionScale / distance;
+
+    if (lods[level].error * pixelsPerUnit > threshold)
+    {
+        while (level > 0 && lods[level].error * pixelsPerUnit > threshold)
+            level--;
+    }
+    else
+    {
+        while (level + 1 < int(lods.size()) && lods[level + 1].error * pixelsPerUnit <= threshold * (1.0f - hysteresis))
+            level++;
+    }
+
+    if (level != previous)
+        stats.switches++;
+    stats.objects[std::min(level, MeshBuilder::MAX_LODS - 1)]++;
+    return level;
+}
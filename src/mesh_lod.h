@@ -0,0 +1,55 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace MeshBuilder
+{
+    const int MAX_LODS = 4;
+
+    // Quadric error metric edge collapse (Garland and Heckbert) that only moves vertices onto
+    // neighbors, so every level keeps using the vertex buffer of level 0. Vertices on open borders and
+    // on attribute seams (one position, several vertices) stay put. Returns indices into mesh.vertices
+    // with at most targetIndexCount entries where the mesh allows it, error gets the largest deviation
+    std::vector<std::uint32_t> simplify(const MeshData& mesh, std::uint32_t firstIndex, std::uint32_t indexCount,
+                                        std::size_t targetIndexCount, float* error);
+
+    // Appends up to MAX_LODS - 1 coarser levels, each about half the triangles of the one before and
+    // ordered for the vertex cache and meshlets like level 0. Stops once the mesh does not simplify further
+    void buildLods(MeshData& mesh, const std::string& name, int maxLods = MAX_LODS, float ratio = 0.5f);
+}
+
+// Picks a level per object from the error it would show on screen. An object only moves to a
+// coarser level once that level's error is well below the threshold and back to a finer one as soon
+// as the threshold is exceeded, so objects hovering around a switch distance do not pop every frame
+class LodSelector
+{
+public:
+    struct Stats
+    {
+        unsigned int switches = 0;
+        std::size_t objects[MeshBuilder::MAX_LODS] = {};
+    };
+
+    float threshold = 1.0f;     // pixels of deviation that are acceptable
+    float hysteresis = 0.25f;   // coarser levels have to stay below threshold * (1 - hysteresis)
+
+    // Reset by the caller, usually once per frame
+    Stats stats;
+
+    // Pixels per unit of size at distance 1, for a perspective projection with the given vertical fov
+    static float projectionScale(float fovY, float viewportHeight);
+
+    // Bounds are the object space sphere of the mesh, model the object's own matrix without the mesh decode
+    int select(unsigned int object, const std::vector<MeshLod>& lods, const glm::vec3& center, float radius,
+               const glm::mat4& model, const glm::vec3& cameraPos, float projectionScale);
+
+private:
+    std::vector<int> current;
+};
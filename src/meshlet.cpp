@@ -0,0 +1,506 @@
+#include "meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESHLET_CULL_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // Unconnected triangles looked at when a meshlet runs out of neighbors
+    const int SEARCH_WINDOW = 256;
+
+    glm::vec3 decodePosition(const PackedVertex& vertex, const glm::mat4& decode)
+    {
+        glm::vec4 snorm(std::max(vertex.position[0] / 32767.0f, -1.0f), std::max(vertex.position[1] / 32767.0f, -1.0f),
+                        std::max(vertex.position[2] / 32767.0f, -1.0f), 1.0f);
+        return glm::vec3(decode * snorm);
+    }
+
+    // Sphere around the box center and a cone around the average triangle normal
+    Meshlet bound(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals, std::uint32_t firstIndex, std::uint32_t vertexCount)
+    {
+        Meshlet meshlet;
+        meshlet.firstIndex = firstIndex;
+        meshlet.triangleCount = std::uint32_t(positions.size() / 3);
+        meshlet.vertexCount = vertexCount;
+
+        glm::vec3 low = positions[0];
+        glm::vec3 high = low;
+        for (const glm::vec3& position : positions)
+            for (int axis = 0; axis < 3; axis++)
+            {
+                low[axis] = std::min(low[axis], position[axis]);
+                high[axis] = std::max(high[axis], position[axis]);
+            }
+
+        meshlet.center = (low + high) * 0.5f;
+        float radius2 = 0.0f;
+        for (const glm::vec3& position : positions)
+        {
+            glm::vec3 offset = position - meshlet.center;
+            radius2 = std::max(radius2, glm::dot(offset, offset));
+        }
+        meshlet.radius = std::sqrt(radius2);
+
+        glm::vec3 sum(0.0f);
+        for (const glm::vec3& normal : normals)
+            sum += normal;
+
+        float length = std::sqrt(glm::dot(sum, sum));
+        meshlet.coneAxis = length > 0.0f ? sum / length : glm::vec3(0.0f, 0.0f, 1.0f);
+        meshlet.coneCutoff = 1.0f;
+
+        if (length > 0.0f && !normals.empty())
+        {
+            float minDot = 1.0f;
+            for (const glm::vec3& normal : normals)
+                minDot = std::min(minDot, glm::dot(normal, meshlet.coneAxis));
+
+            // Cones wider than about 84 degrees reject almost nothing, they are left disabled
+            if (minDot > 0.1f)
+                meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+        }
+
+        return meshlet;
+    }
+
+    // Vertex cache and overdraw passes over one meshlet, on a copy holding only its own vertices so the
+    // adjacency stays small. The first triangle is moved back to the front afterwards, it is the one
+    // that did not fit the meshlet before and the in-order cut depends on it
+    void optimizeInside(const MeshData& mesh, std::uint32_t* indices, std::size_t indexCount, const glm::vec3& meshCenter, int cacheSize)
+    {
+        if (indexCount < 6)
+            return;
+
+        MeshData local;
+        std::vector<std::uint32_t> global;
+        local.indices.reserve(indexCount);
+        for (std::size_t i = 0; i < indexCount; i++)
+        {
+            std::size_t vertex = std::find(global.begin(), global.end(), indices[i]) - global.begin();
+            if (vertex == global.size())
+            {
+                global.push_back(indices[i]);
+                local.vertices.push_back(mesh.vertices[indices[i]]);
+            }
+            local.indices.push_back(std::uint32_t(vertex));
+        }
+
+        const std::uint32_t first[3] = { local.indices[0], local.indices[1], local.indices[2] };
+
+        std::vector<std::size_t> clusters;
+        MeshBuilder::optimizeVertexCache(local, cacheSize, &clusters);
+        MeshBuilder::optimizeOverdraw(local, clusters, meshCenter);
+
+        // Both passes move whole triangles and keep their winding
+        std::size_t at = 0;
+        while (local.indices[at] != first[0] || local.indices[at + 1] != first[1] || local.indices[at + 2] != first[2])
+            at += 3;
+        std::rotate(local.indices.begin(), local.indices.begin() + at, local.indices.begin() + at + 3);
+
+        for (std::size_t i = 0; i < indexCount; i++)
+            indices[i] = global[local.indices[i]];
+    }
+}
+
+std::size_t MeshBuilder::optimizeMeshlets(MeshData& mesh, int maxVertices, int maxTriangles, int cacheSize)
+{
+    std::vector<Submesh> ranges = mesh.submeshes;
+    if (ranges.empty())
+        ranges.push_back(submesh(mesh, 0, std::uint32_t(mesh.indices.size())));
+
+    glm::vec3 meshCenter(0.0f);
+    for (const Vertex& vertex : mesh.vertices)
+        meshCenter += vertex.position;
+    if (!mesh.vertices.empty())
+        meshCenter /= float(mesh.vertices.size());
+    std::size_t meshletCount = 0;
+
+    // Anything outside the submeshes stays where it was
+    std::vector<std::uint32_t> reordered(mesh.indices);
+    std::vector<std::uint32_t> stamp(mesh.vertices.size(), 0);
+    std::uint32_t current = 1;
+
+    for (const Submesh& range : ranges)
+    {
+        const std::uint32_t* indices = mesh.indices.data() + range.firstIndex;
+        std::size_t triangleCount = range.indexCount / 3;
+        if (triangleCount == 0)
+            continue;
+
+        // Triangles around every vertex, as offsets into one shared list
+        std::vector<std::uint32_t> start(mesh.vertices.size() + 1, 0);
+        for (std::size_t i = 0; i < triangleCount * 3; i++)
+            start[indices[i] + 1]++;
+        for (std::size_t v = 0; v < mesh.vertices.size(); v++)
+            start[v + 1] += start[v];
+
+        std::vector<std::uint32_t> adjacent(triangleCount * 3);
+        std::vector<std::uint32_t> fill(start.begin(), start.end() - 1);
+        for (std::size_t i = 0; i < triangleCount * 3; i++)
+            adjacent[fill[indices[i]]++] = std::uint32_t(i / 3);
+
+        std::vector<glm::vec3> centroids(triangleCount);
+        for (std::size_t t = 0; t < triangleCount; t++)
+            centroids[t] = (mesh.vertices[indices[t * 3 + 0]].position + mesh.vertices[indices[t * 3 + 1]].position +
+                            mesh.vertices[indices[t * 3 + 2]].position) / 3.0f;
+
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<std::uint32_t> candidates;
+        std::size_t nextSeed = 0;
+        std::size_t written = range.firstIndex;
+        std::size_t meshletBegin = written;
+
+        int used = 0;
+        int triangles = 0;
+        glm::vec3 centerSum(0.0f);
+
+        for (std::size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+        {
+            // Best neighbor of the open meshlet: fewest new vertices, then closest to its center
+            std::uint32_t best = std::uint32_t(-1);
+            int bestNew = 4;
+            float bestDistance = 0.0f;
+            glm::vec3 center = triangles ? centerSum / float(triangles) : glm::vec3(0.0f);
+
+            for (std::uint32_t t : candidates)
+            {
+                if (emitted[t])
+                    continue;
+
+                int added = 0;
+                for (int corner = 0; corner < 3; corner++)
+                    if (stamp[indices[t * 3 + corner]] != current)
+                        added++;
+
+                glm::vec3 offset = centroids[t] - center;
+                float distance = glm::dot(offset, offset);
+                if (added < bestNew || (added == bestNew && distance < bestDistance))
+                {
+                    best = t;
+                    bestNew = added;
+                    bestDistance = distance;
+                }
+            }
+
+            // Nothing connected left (or split normals left nothing connected to begin with), the closest
+            // of the next few triangles in the existing order continues the meshlet
+            if (best == std::uint32_t(-1))
+            {
+                while (emitted[nextSeed])
+                    nextSeed++;
+
+                best = std::uint32_t(nextSeed);
+                int looked = 0;
+                for (std::size_t t = nextSeed; triangles && t < triangleCount && looked < SEARCH_WINDOW; t++)
+                {
+                    if (emitted[t])
+                        continue;
+                    looked++;
+
+                    glm::vec3 offset = centroids[t] - center;
+                    float distance = glm::dot(offset, offset);
+                    if (t == nextSeed || distance < bestDistance)
+                    {
+                        best = std::uint32_t(t);
+                        bestDistance = distance;
+                    }
+                }
+
+                bestNew = 0;
+                for (int corner = 0; corner < 3; corner++)
+                    if (stamp[indices[best * 3 + corner]] != current)
+                        bestNew++;
+            }
+
+            // Closing exactly where the in-order cut in meshlets() will close keeps the two in sync
+            if (used + bestNew > maxVertices || triangles >= maxTriangles)
+            {
+                optimizeInside(mesh, &reordered[meshletBegin], written - meshletBegin, meshCenter, cacheSize);
+                meshletBegin = written;
+                meshletCount++;
+
+                current++;
+                candidates.clear();
+                used = 0;
+                triangles = 0;
+                centerSum = glm::vec3(0.0f);
+            }
+
+            emitted[best] = true;
+            triangles++;
+            centerSum += centroids[best];
+            for (int corner = 0; corner < 3; corner++)
+            {
+                std::uint32_t vertex = indices[best * 3 + corner];
+                reordered[written++] = vertex;
+                if (stamp[vertex] != current)
+                {
+                    stamp[vertex] = current;
+                    used++;
+                    for (std::uint32_t a = start[vertex]; a < start[vertex + 1]; a++)
+                        if (!emitted[adjacent[a]])
+                            candidates.push_back(adjacent[a]);
+                }
+            }
+
+            // Keeps the candidate scan short, emitted triangles are dropped once they pile up
+            if (candidates.size() > std::size_t(maxVertices) * 8)
+                candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](std::uint32_t t) { return emitted[t]; }), candidates.end());
+        }
+
+        optimizeInside(mesh, &reordered[meshletBegin], written - meshletBegin, meshCenter, cacheSize);
+        meshletCount++;
+        current++;
+    }
+
+    mesh.indices.swap(reordered);
+    return meshletCount;
+}
+
+std::vector<Meshlet> MeshBuilder::meshlets(const PackedVertex* vertices, std::size_t vertexCount, const std::uint32_t* indices, std::size_t indexCount,
+                                           const std::vector<Submesh>& submeshes, const glm::mat4& decode, int maxVertices, int maxTriangles)
+{
+    std::vector<Meshlet> result;
+
+    std::vector<glm::vec3> decoded(vertexCount);
+    for (std::size_t i = 0; i < vertexCount; i++)
+        decoded[i] = decodePosition(vertices[i], decode);
+
+    std::vector<Submesh> ranges = submeshes;
+    if (ranges.empty())
+    {
+        Submesh whole = Submesh();
+        whole.indexCount = std::uint32_t(indexCount);
+        ranges.push_back(whole);
+    }
+
+    // Stamp of the meshlet that last used each vertex, counts unique vertices without clearing anything
+    std::vector<std::uint32_t> stamp(vertexCount, 0);
+    std::uint32_t current = 1;
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::uint32_t first = 0;
+    std::uint32_t used = 0;
+
+    for (const Submesh& range : ranges)
+    {
+        std::uint32_t end = range.firstIndex + range.indexCount;
+        first = range.firstIndex;
+        positions.clear();
+        normals.clear();
+        used = 0;
+
+        for (std::uint32_t i = range.firstIndex; i + 2 < end && i + 2 < indexCount; i += 3)
+        {
+            const std::uint32_t* triangle = indices + i;
+
+            int added = 0;
+            for (int corner = 0; corner < 3; corner++)
+                if (stamp[triangle[corner]] != current)
+                    added++;
+
+            if (used + added > std::uint32_t(maxVertices) || positions.size() / 3 >= std::size_t(maxTriangles))
+            {
+                result.push_back(bound(positions, normals, first, used));
+                positions.clear();
+                normals.clear();
+                first = i;
+                used = 0;
+                current++;
+            }
+
+            for (int corner = 0; corner < 3; corner++)
+            {
+                if (stamp[triangle[corner]] != current)
+                {
+                    stamp[triangle[corner]] = current;
+                    used++;
+                }
+                positions.push_back(decoded[triangle[corner]]);
+            }
+
+            // Degenerate triangles face nowhere and do not widen the cone
+            glm::vec3 normal = glm::cross(positions[positions.size() - 2] - positions[positions.size() - 3],
+                                          positions[positions.size() - 1] - positions[positions.size() - 3]);
+            float area = std::sqrt(glm::dot(normal, normal));
+            if (area > 0.0f)
+                normals.push_back(normal / area);
+        }
+
+        if (!positions.empty())
+            result.push_back(bound(positions, normals, first, used));
+        current++;
+    }
+
+    return result;
+}
+
+MeshletCuller::MeshletCuller(const std::vector<Meshlet>& meshlets)
+    : count(meshlets.size())
+{
+    std::size_t padded = (count + 3) & ~std::size_t(3);
+    centerX.assign(padded, 0.0f);
+    centerY.assign(padded, 0.0f);
+    centerZ.assign(padded, 0.0f);
+    radius.assign(padded, -std::numeric_limits<float>::max());
+    axisX.assign(padded, 0.0f);
+    axisY.assign(padded, 0.0f);
+    axisZ.assign(padded, 1.0f);
+    cutoff.assign(padded, 1.0f);
+    visible.assign(padded, 0);
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const Meshlet& meshlet = meshlets[i];
+        centerX[i] = meshlet.center.x;
+        centerY[i] = meshlet.center.y;
+        centerZ[i] = meshlet.center.z;
+        radius[i] = meshlet.radius;
+        axisX[i] = meshlet.coneAxis.x;
+        axisY[i] = meshlet.coneAxis.y;
+        axisZ[i] = meshlet.coneAxis.z;
+        cutoff[i] = meshlet.coneCutoff;
+
+        firstIndex.push_back(meshlet.firstIndex);
+        triangleCount.push_back(meshlet.triangleCount);
+        triangles += meshlet.triangleCount;
+    }
+}
+
+void MeshletCuller::frustumPlanes(const glm::mat4& viewProj, glm::vec4 planes[6])
+{
+    // Straight from the matrix rows, normalized so distances compare against radii
+    for (int i = 0; i < 3; i++)
+    {
+        glm::vec4 row(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+        glm::vec4 w(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+        planes[i * 2 + 0] = glm::vec4(w.x + row.x, w.y + row.y, w.z + row.z, w.w + row.w);
+        planes[i * 2 + 1] = glm::vec4(w.x - row.x, w.y - row.y, w.z - row.z, w.w - row.w);
+    }
+    for (int i = 0; i < 6; i++)
+    {
+        glm::vec4& plane = planes[i];
+        float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        plane = glm::vec4(plane.x / length, plane.y / length, plane.z / length, plane.w / length);
+    }
+}
+
+void MeshletCuller::cull(const glm::mat4& model, const glm::mat4& viewProj, const glm::vec3& cameraPos,
+                         std::vector<GLsizei>& counts, std::vector<const void*>& offsets)
+{
+    stats.meshlets += (unsigned int)count;
+    stats.trianglesSubmitted += triangles;
+
+    glm::vec4 planes[6];
+    frustumPlanes(viewProj, planes);
+
+    float scaleX = std::sqrt(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])));
+    float scaleY = std::sqrt(glm::dot(glm::vec3(model[1]), glm::vec3(model[1])));
+    float scaleZ = std::sqrt(glm::dot(glm::vec3(model[2]), glm::vec3(model[2])));
+    float scale = std::max(scaleX, std::max(scaleY, scaleZ));
+    bool coneTest = scale > 0.0f && std::min(scaleX, std::min(scaleY, scaleZ)) > scale * 0.99f;
+    float axisScale = scale > 0.0f ? 1.0f / scale : 0.0f;
+
+#ifdef MESHLET_CULL_SSE
+    const __m128 m00 = _mm_set1_ps(model[0][0]), m01 = _mm_set1_ps(model[0][1]), m02 = _mm_set1_ps(model[0][2]);
+    const __m128 m10 = _mm_set1_ps(model[1][0]), m11 = _mm_set1_ps(model[1][1]), m12 = _mm_set1_ps(model[1][2]);
+    const __m128 m20 = _mm_set1_ps(model[2][0]), m21 = _mm_set1_ps(model[2][1]), m22 = _mm_set1_ps(model[2][2]);
+    const __m128 m30 = _mm_set1_ps(model[3][0]), m31 = _mm_set1_ps(model[3][1]), m32 = _mm_set1_ps(model[3][2]);
+    const __m128 radiusScale = _mm_set1_ps(scale);
+    const __m128 axisNormalize = _mm_set1_ps(axisScale);
+    const __m128 camX = _mm_set1_ps(cameraPos.x), camY = _mm_set1_ps(cameraPos.y), camZ = _mm_set1_ps(cameraPos.z);
+
+    for (std::size_t i = 0; i < centerX.size(); i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(&centerX[i]);
+        __m128 cy = _mm_loadu_ps(&centerY[i]);
+        __m128 cz = _mm_loadu_ps(&centerZ[i]);
+
+        __m128 wx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, cx), _mm_mul_ps(m10, cy)), _mm_add_ps(_mm_mul_ps(m20, cz), m30));
+        __m128 wy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, cx), _mm_mul_ps(m11, cy)), _mm_add_ps(_mm_mul_ps(m21, cz), m31));
+        __m128 wz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, cx), _mm_mul_ps(m12, cy)), _mm_add_ps(_mm_mul_ps(m22, cz), m32));
+        __m128 r = _mm_mul_ps(_mm_loadu_ps(&radius[i]), radiusScale);
+        __m128 negativeR = _mm_sub_ps(_mm_setzero_ps(), r);
+
+        // Inside unless the sphere is completely behind one of the planes
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const glm::vec4& plane : planes)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), wx), _mm_mul_ps(_mm_set1_ps(plane.y), wy)),
+                                         _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), wz), _mm_set1_ps(plane.w)));
+            inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, negativeR));
+        }
+
+        if (coneTest)
+        {
+            __m128 ax = _mm_loadu_ps(&axisX[i]);
+            __m128 ay = _mm_loadu_ps(&axisY[i]);
+            __m128 az = _mm_loadu_ps(&axisZ[i]);
+            __m128 wax = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, ax), _mm_mul_ps(m10, ay)), _mm_mul_ps(m20, az)), axisNormalize);
+            __m128 way = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, ax), _mm_mul_ps(m11, ay)), _mm_mul_ps(m21, az)), axisNormalize);
+            __m128 waz = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, ax), _mm_mul_ps(m12, ay)), _mm_mul_ps(m22, az)), axisNormalize);
+
+            // Every triangle faces away when the view direction is inside the cone: dot(d, axis) >= cutoff * |d| + r
+            __m128 dx = _mm_sub_ps(wx, camX), dy = _mm_sub_ps(wy, camY), dz = _mm_sub_ps(wz, camZ);
+            __m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, wax), _mm_mul_ps(dy, way)), _mm_mul_ps(dz, waz));
+            __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+            __m128 backfacing = _mm_cmpge_ps(along, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&cutoff[i]), distance), r));
+            inside = _mm_andnot_ps(backfacing, inside);
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        visible[i + 0] = std::uint8_t(mask & 1);
+        visible[i + 1] = std::uint8_t((mask >> 1) & 1);
+        visible[i + 2] = std::uint8_t((mask >> 2) & 1);
+        visible[i + 3] = std::uint8_t((mask >> 3) & 1);
+    }
+#else
+    for (std::size_t i = 0; i < count; i++)
+    {
+        glm::vec3 center(model * glm::vec4(centerX[i], centerY[i], centerZ[i], 1.0f));
+        float r = radius[i] * scale;
+
+        bool inside = true;
+        for (const glm::vec4& plane : planes)
+            inside = inside && plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w > -r;
+
+        if (inside && coneTest)
+        {
+            glm::vec3 axis = glm::vec3(model * glm::vec4(axisX[i], axisY[i], axisZ[i], 0.0f)) * axisScale;
+            glm::vec3 offset = center - cameraPos;
+            inside = glm::dot(offset, axis) < cutoff[i] * std::sqrt(glm::dot(offset, offset)) + r;
+        }
+
+        visible[i] = inside ? 1 : 0;
+    }
+#endif
+
+    std::size_t firstRange = counts.size();
+    for (std::size_t i = 0; i < count; i++)
+    {
+        if (!visible[i])
+            continue;
+
+        stats.visible++;
+        stats.trianglesVisible += triangleCount[i];
+
+        GLsizei indices = GLsizei(triangleCount[i] * 3);
+        const void* offset = (const void*)(std::uintptr_t(firstIndex[i]) * sizeof(std::uint32_t));
+
+        // Back to back meshlets of this instance become one range
+        if (counts.size() > firstRange && (const char*)offsets.back() + counts.back() * sizeof(std::uint32_t) == (const char*)offset)
+            counts.back() += indices;
+        else
+        {
+            counts.push_back(indices);
+            offsets.push_back(offset);
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+namespace MeshBuilder
+{
+    const int MESHLET_VERTICES = 64;
+    const int MESHLET_TRIANGLES = 124;
+
+    // Reorders the triangles of every submesh so that cutting the index buffer in order gives compact
+    // meshlets. Each meshlet grows through the triangles sharing the most vertices with it, closest to
+    // its center first, and only closes once the next pick would not fit. The vertex cache and
+    // overdraw passes then reorder the triangles inside each meshlet, its first triangle stays first
+    // so the cut does not move. Returns the number of meshlets, part of build()
+    std::size_t optimizeMeshlets(MeshData& mesh, int maxVertices = MESHLET_VERTICES, int maxTriangles = MESHLET_TRIANGLES,
+                                 int cacheSize = CACHE_SIZE);
+
+    // Cuts the index buffer into meshlets in order, without reordering it. After optimizeMeshlets this
+    // finds exactly the clusters it built. Meshlets never cross a submesh. Works on the packed data,
+    // so meshes straight from a file get them too
+    std::vector<Meshlet> meshlets(const PackedVertex* vertices, std::size_t vertexCount, const std::uint32_t* indices, std::size_t indexCount,
+                                  const std::vector<Submesh>& submeshes, const glm::mat4& decode,
+                                  int maxVertices = MESHLET_VERTICES, int maxTriangles = MESHLET_TRIANGLES);
+}
+
+// Frustum and backface culling of meshlets on the CPU, four at a time with SSE where available.
+// The visible ones come out as index ranges for a single glMultiDrawElements. Front faces are
+// counter-clockwise, the GL default
+class MeshletCuller
+{
+public:
+    struct Stats
+    {
+        unsigned int meshlets = 0;
+        unsigned int visible = 0;
+        std::size_t trianglesSubmitted = 0;
+        std::size_t trianglesVisible = 0;
+    };
+
+    // Reset by the caller, usually once per frame
+    Stats stats;
+
+    explicit MeshletCuller(const std::vector<Meshlet>& meshlets);
+
+    // World space planes of the view frustum, a sphere is outside once dot(plane.xyz, center) + plane.w < -radius for any of them
+    static void frustumPlanes(const glm::mat4& viewProj, glm::vec4 planes[6]);
+
+    // Appends the visible ranges of one instance, neighbors in the index buffer merge into one range.
+    // The model matrix is the object's own, without the mesh decode matrix. The cone test is skipped
+    // when it scales the axes unevenly, normals would not transform like the cone then
+    void cull(const glm::mat4& model, const glm::mat4& viewProj, const glm::vec3& cameraPos,
+              std::vector<GLsizei>& counts, std::vector<const void*>& offsets);
+
+private:
+    // Structure of arrays padded to a multiple of four, padding never passes the frustum test
+    std::vector<float> centerX, centerY, centerZ, radius;
+    std::vector<float> axisX, axisY, axisZ, cutoff;
+
+    std::vector<std::uint32_t> firstIndex;
+    std::vector<std::uint32_t> triangleCount;
+    std::size_t count;
+    std::size_t triangles = 0;
+
+    std::vector<std::uint8_t> visible;
+};
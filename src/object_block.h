@@ -0,0 +1,23 @@
+#pragma once
+
+#include "block_layout.h"
+
+#include <glm/glm.hpp>
+
+// Binding point of the ObjectBuffer storage block, fixed in the shaders with layout(binding = 1)
+const unsigned int OBJECT_BUFFER_BINDING = 1;
+
+// std430 element of ObjectBuffer in vertex.glsl. Everything a draw needs lives here, the draw
+// itself only selects its entry through objectIndex
+struct ObjectData
+{
+    glm::mat4 model;
+    glm::ivec4 layers;      // base layer, detail layer, OBJECT_* flags, unused
+};
+
+// Flags in layers.z, mirrored in scene_blocks.glsl
+const int OBJECT_HALF_TEXCOORDS = 1;    // the mesh stores texture coordinates as half floats
+
+BLOCK_FIRST(Std430, ObjectData, model);
+BLOCK_NEXT(Std430, ObjectData, model, layers);
+BLOCK_END(Std430, ObjectData, layers, 16);
@@ -0,0 +1,161 @@
+#include "program_cache.h"
+
+#include <glad/glad.h>
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+    const char* CACHE_DIRECTORY = "shadercache";
+    const std::uint32_t CACHE_MAGIC = 0x58464750;     // "PGFX"
+    const std::uint32_t CACHE_VERSION = 1;
+
+    struct CacheHeader
+    {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint64_t key;
+        std::uint32_t binaryFormat;
+        std::uint32_t length;
+    };
+
+    std::uint64_t hashBytes(std::uint64_t hash, const char* data, std::size_t size)
+    {
+        for (std::size_t i = 0; i < size; i++)
+        {
+            hash ^= (unsigned char)data[i];
+            hash *= 1099511628211ull;
+        }
+        // Separator so "ab" + "c" and "a" + "bc" differ
+        hash ^= 0xFF;
+        hash *= 1099511628211ull;
+        return hash;
+    }
+
+    std::string cachePath(std::uint64_t key)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return std::string(CACHE_DIRECTORY) + "/" + name;
+    }
+
+    bool binariesSupported()
+    {
+        int formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+}
+
+std::uint64_t ProgramCache::key(const std::string& vertexCode, const std::string& fragmentCode)
+{
+    std::string renderer = (const char*)glGetString(GL_RENDERER);
+    std::string version = (const char*)glGetString(GL_VERSION);
+
+    std::uint64_t hash = 14695981039346656037ull;
+    hash = hashBytes(hash, vertexCode.data(), vertexCode.size());
+    hash = hashBytes(hash, fragmentCode.data(), fragmentCode.size());
+    hash = hashBytes(hash, renderer.data(), renderer.size());
+    hash = hashBytes(hash, version.data(), version.size());
+    return hash;
+}
+
+bool ProgramCache::load(unsigned int program, std::uint64_t key)
+{
+    if (!binariesSupported())
+        return false;
+
+    FILE* file = std::fopen(cachePath(key).c_str(), "rb");
+    if (!file)
+        return false;
+
+    // The length in the header has to account for the rest of the file exactly, a truncated or
+    // corrupt entry is a miss rather than a huge allocation
+    long fileSize = -1;
+    if (std::fseek(file, 0, SEEK_END) == 0)
+        fileSize = std::ftell(file);
+    std::rewind(file);
+
+    CacheHeader header;
+    std::vector<char> binary;
+    bool ok = fileSize >= (long)sizeof(header) && std::fread(&header, sizeof(header), 1, file) == 1 &&
+              header.magic == CACHE_MAGIC && header.version == CACHE_VERSION && header.key == key &&
+              header.length == (unsigned long)fileSize - sizeof(header);
+    if (ok)
+    {
+        binary.resize(header.length);
+        ok = std::fread(binary.data(), 1, binary.size(), file) == binary.size();
+    }
+    std::fclose(file);
+
+    if (!ok)
+        return false;
+
+    glProgramBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+
+    // Drivers are free to refuse a binary they produced earlier, that only costs a recompile
+    int success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+        std::cout << "PROGRAM_BINARY_CACHE::STALE " << cachePath(key) << std::endl;
+    return success != 0;
+}
+
+void ProgramCache::store(unsigned int program, std::uint64_t key)
+{
+    if (!binariesSupported())
+        return;
+
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<char> binary(length);
+    GLenum binaryFormat = 0;
+    glGetProgramBinary(program, length, &length, &binaryFormat, binary.data());
+
+#ifdef _WIN32
+    _mkdir(CACHE_DIRECTORY);
+#else
+    mkdir(CACHE_DIRECTORY, 0755);
+#endif
+
+    // Written under a temporary name first so a crash never leaves a torn entry behind
+    std::string path = cachePath(key);
+    std::string temporary = path + ".tmp";
+    FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file)
+    {
+        std::cout << "ERROR::PROGRAM_BINARY_CACHE::NOT_WRITABLE " << path << std::endl;
+        return;
+    }
+
+    CacheHeader header = { CACHE_MAGIC, CACHE_VERSION, key, binaryFormat, (std::uint32_t)length };
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(binary.data(), 1, length, file) == (std::size_t)length;
+    ok = std::fclose(file) == 0 && ok;
+
+    // rename replaces an existing entry in one step on POSIX. Windows refuses to, only there the old
+    // entry is removed first and a reader may briefly see a miss
+    bool renamed = ok && std::rename(temporary.c_str(), path.c_str()) == 0;
+    if (ok && !renamed)
+    {
+        std::remove(path.c_str());
+        renamed = std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+
+    if (!renamed)
+    {
+        std::remove(temporary.c_str());
+        std::cout << "ERROR::PROGRAM_BINARY_CACHE::NOT_WRITABLE " << path << std::endl;
+    }
+}
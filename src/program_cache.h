@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// On-disk cache of linked program binaries. Entries are keyed by the shader sources together
+// with GL_RENDERER and GL_VERSION, so a driver update or a different GPU simply misses
+namespace ProgramCache
+{
+    std::uint64_t key(const std::string& vertexCode, const std::string& fragmentCode);
+
+    // Returns false, leaving the program unlinked, when there is no entry or the driver rejects it
+    bool load(unsigned int program, std::uint64_t key);
+
+    // The program must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+    void store(unsigned int program, std::uint64_t key);
+}
@@ -0,0 +1,107 @@
+#include "sampler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#ifndef GL_TEXTURE_MAX_ANISOTROPY
+#define GL_TEXTURE_MAX_ANISOTROPY 0x84FE
+#endif
+
+#ifndef GL_MAX_TEXTURE_MAX_ANISOTROPY
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY 0x84FF
+#endif
+
+bool SamplerState::operator==(const SamplerState& other) const
+{
+    return minFilter == other.minFilter && magFilter == other.magFilter &&
+           wrapS == other.wrapS && wrapT == other.wrapT && wrapR == other.wrapR &&
+           lodBias == other.lodBias && anisotropic == other.anisotropic;
+}
+
+std::size_t SamplerStateHash::operator()(const SamplerState& state) const
+{
+    std::size_t hash = std::hash<float>()(state.lodBias);
+    const unsigned int fields[] = { state.minFilter, state.magFilter, state.wrapS, state.wrapT, state.wrapR, state.anisotropic };
+    for (unsigned int field : fields)
+        hash = hash * 31 + field;
+    return hash;
+}
+
+SamplerCache::~SamplerCache()
+{
+    clear();
+}
+
+unsigned int SamplerCache::get(const SamplerState& state)
+{
+    auto it = samplers.find(state);
+    if (it != samplers.end())
+        return it->second;
+
+    unsigned int sampler;
+    glCreateSamplers(1, &sampler);
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, state.minFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, state.magFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, state.wrapS);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, state.wrapT);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, state.wrapR);
+    glSamplerParameterf(sampler, GL_TEXTURE_LOD_BIAS, state.lodBias);
+
+    if (state.anisotropic)
+        applyAnisotropy(sampler);
+
+    samplers.emplace(state, sampler);
+    return sampler;
+}
+
+void SamplerCache::setAnisotropy(float level)
+{
+    anisotropy = level;
+
+    for (const auto& entry : samplers)
+        if (entry.first.anisotropic)
+            applyAnisotropy(entry.second);
+}
+
+void SamplerCache::bind(unsigned int first, std::initializer_list<unsigned int> list) const
+{
+    bind(first, list.begin(), (int)list.size());
+}
+
+void SamplerCache::bind(unsigned int first, const unsigned int* ids, int count) const
+{
+    glBindSamplers(first, count, ids);
+}
+
+void SamplerCache::clear()
+{
+    for (const auto& entry : samplers)
+        glDeleteSamplers(1, &entry.second);
+    samplers.clear();
+}
+
+void SamplerCache::applyAnisotropy(unsigned int sampler) const
+{
+    // Core in 4.6, EXT_texture_filter_anisotropic before that
+    if (maxAnisotropy == 0.0f)
+    {
+        maxAnisotropy = -1.0f;
+
+        int count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (int i = 0; i < count; i++)
+        {
+            const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (std::strcmp(name, "GL_EXT_texture_filter_anisotropic") == 0 ||
+                std::strcmp(name, "GL_ARB_texture_filter_anisotropic") == 0)
+            {
+                glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAnisotropy);
+                break;
+            }
+        }
+    }
+
+    if (maxAnisotropy > 0.0f)
+        glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY, std::min(std::max(anisotropy, 1.0f), maxAnisotropy));
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <initializer_list>
+#include <unordered_map>
+#include <vector>
+
+// Filtering and addressing state, shared by every texture sampled through it
+struct SamplerState
+{
+    GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLenum magFilter = GL_LINEAR;
+
+    GLenum wrapS = GL_REPEAT;
+    GLenum wrapT = GL_REPEAT;
+    GLenum wrapR = GL_REPEAT;
+
+    float lodBias = 0.0f;
+
+    // Anisotropic samplers follow the global quality tier set on the cache
+    bool anisotropic = false;
+
+    bool operator==(const SamplerState& other) const;
+};
+
+struct SamplerStateHash
+{
+    std::size_t operator()(const SamplerState& state) const;
+};
+
+// Hands out one GL sampler object per unique SamplerState
+class SamplerCache
+{
+public:
+    SamplerCache() = default;
+    ~SamplerCache();
+
+    SamplerCache(const SamplerCache&) = delete;
+    SamplerCache& operator=(const SamplerCache&) = delete;
+
+    unsigned int get(const SamplerState& state);
+
+    // Changes the anisotropy of every anisotropic sampler in place, textures are left untouched
+    void setAnisotropy(float level);
+
+    // One multi-bind for the whole draw batch, samplers[i] goes to unit first + i
+    void bind(unsigned int first, std::initializer_list<unsigned int> samplers) const;
+    void bind(unsigned int first, const unsigned int* samplers, int count) const;
+
+    std::size_t size() const { return samplers.size(); }
+
+    void clear();
+
+private:
+    void applyAnisotropy(unsigned int sampler) const;
+
+    std::unordered_map<SamplerState, unsigned int, SamplerStateHash> samplers;
+
+    float anisotropy = 1.0f;
+    mutable float maxAnisotropy = 0.0f;     // 0 until queried, -1 when unsupported
+};
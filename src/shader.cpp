@@ -1,55 +1,80 @@
 #include "shader.h"
+#include "program_cache.h"
+#include "shader_source.h"
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath)
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines)
 {
-    // Throw exceptions in case of file error
-    vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-    try
-    {
-        // calling the open() method from the ifstream class
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        // read from filebuffer into streams
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        // close the files for security
-        vShaderFile.close();
-        fShaderFile.close();
-        // convert streams into strings
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-        // convert strings into C-style char arrays
-        vShaderCode = vertexCode.c_str();
-        fShaderCode = fragmentCode.c_str();
-    }
-    catch (std::ifstream::failure& e)
+    std::string vertexCode;
+    std::string fragmentCode;
+    if (!ShaderSource::load(vertexPath, defines, vertexCode) || !ShaderSource::load(fragmentPath, defines, fragmentCode))
     {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
     }
 
+        //--------------------------------------------
+        // Program binary cache
+        //--------------------------------------------
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::uint64_t cacheKey = ProgramCache::key(vertexCode, fragmentCode);
+
+        ID = glCreateProgram();
+        if (ProgramCache::load(ID, cacheKey))
+        {
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "PROGRAM_BINARY_CACHE::HIT warm start in " << elapsed.count() << " ms" << std::endl;
+
+            reflect();
+            return;
+        }
+
+        // A rejected binary leaves the program in an unknown state, start over
+        glDeleteProgram(ID);
+
         //--------------------------------------------
         // Shader Compilation
         //--------------------------------------------
 
-        vertex = glCreateShader(GL_VERTEX_SHADER);
+        const char* vShaderCode = vertexCode.c_str();
+        const char* fShaderCode = fragmentCode.c_str();
+
+        unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex, 1, &vShaderCode, NULL);
         glCompileShader(vertex);
         checkCompileErrors(vertex, "VERTEX");
 
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        unsigned int fragment = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(fragment, 1, &fShaderCode, NULL);
         glCompileShader(fragment);
         checkCompileErrors(fragment, "FRAGMENT");
 
         ID = glCreateProgram();
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
         glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        bool linked = checkCompileErrors(ID, "PROGRAM");
 
         glDeleteShader(vertex);
         glDeleteShader(fragment);
+
+        if (linked)
+            ProgramCache::store(ID, cacheKey);
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "PROGRAM_BINARY_CACHE::MISS cold start in " << elapsed.count() << " ms" << std::endl;
+
+        reflect();
+}
+
+Shader::Shader(unsigned int program)
+    : ID(program)
+{
+    reflect();
 }
 
 void Shader::use()
@@ -57,59 +82,351 @@ void Shader::use()
     glUseProgram(ID);
 }
 
+namespace
+{
+    // Copies the current value of every plain uniform of one program into the same named uniform of another
+    void copyUniformValues(unsigned int from, unsigned int to)
+    {
+        int count = 0;
+        int maxLength = 0;
+        glGetProgramiv(from, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(from, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::string name(maxLength > 0 ? maxLength : 1, '\0');
+        for (int i = 0; i < count; i++)
+        {
+            int length = 0;
+            int size = 0;
+            GLenum type;
+            glGetActiveUniform(from, i, maxLength, &length, &size, &type, &name[0]);
+
+            std::string base = name.substr(0, length);
+            std::size_t bracket = base.find('[');
+            if (bracket != std::string::npos)
+                base.resize(bracket);
+
+            for (int element = 0; element < size; element++)
+            {
+                std::string elementName = size > 1 ? base + "[" + std::to_string(element) + "]" : base;
+                int source = glGetUniformLocation(from, elementName.c_str());
+                int target = glGetUniformLocation(to, elementName.c_str());
+                if (source < 0 || target < 0)
+                    continue;
+
+                float f[16];
+                int n[4];
+                unsigned int u[4];
+                switch (type)
+                {
+                case GL_FLOAT:             glGetUniformfv(from, source, f); glProgramUniform1fv(to, target, 1, f); break;
+                case GL_FLOAT_VEC2:        glGetUniformfv(from, source, f); glProgramUniform2fv(to, target, 1, f); break;
+                case GL_FLOAT_VEC3:        glGetUniformfv(from, source, f); glProgramUniform3fv(to, target, 1, f); break;
+                case GL_FLOAT_VEC4:        glGetUniformfv(from, source, f); glProgramUniform4fv(to, target, 1, f); break;
+                case GL_FLOAT_MAT2:        glGetUniformfv(from, source, f); glProgramUniformMatrix2fv(to, target, 1, GL_FALSE, f); break;
+                case GL_FLOAT_MAT3:        glGetUniformfv(from, source, f); glProgramUniformMatrix3fv(to, target, 1, GL_FALSE, f); break;
+                case GL_FLOAT_MAT4:        glGetUniformfv(from, source, f); glProgramUniformMatrix4fv(to, target, 1, GL_FALSE, f); break;
+                case GL_FLOAT_MAT2x3:      glGetUniformfv(from, source, f); glProgramUniformMatrix2x3fv(to, target, 1, GL_FALSE, f); break;
+                case GL_FLOAT_MAT2x4:      glGetUniformfv(from, source, f); glProgramUniformMatrix2x4fv(to, target, 1, GL_FALSE, f); break;
+                case GL_FLOAT_MAT3x2:      glGetUniformfv(from, source, f); glProgramUniformMatrix3x2fv(to, target, 1, GL_FALSE, f); break;
+                case GL_FLOAT_MAT3x4:      glGetUniformfv(from, source, f); glProgramUniformMatrix3x4fv(to, target, 1, GL_FALSE, f); break;
+                case GL_FLOAT_MAT4x2:      glGetUniformfv(from, source, f); glProgramUniformMatrix4x2fv(to, target, 1, GL_FALSE, f); break;
+                case GL_FLOAT_MAT4x3:      glGetUniformfv(from, source, f); glProgramUniformMatrix4x3fv(to, target, 1, GL_FALSE, f); break;
+                case GL_INT_VEC2:
+                case GL_BOOL_VEC2:         glGetUniformiv(from, source, n); glProgramUniform2iv(to, target, 1, n); break;
+                case GL_INT_VEC3:
+                case GL_BOOL_VEC3:         glGetUniformiv(from, source, n); glProgramUniform3iv(to, target, 1, n); break;
+                case GL_INT_VEC4:
+                case GL_BOOL_VEC4:         glGetUniformiv(from, source, n); glProgramUniform4iv(to, target, 1, n); break;
+                case GL_UNSIGNED_INT:      glGetUniformuiv(from, source, u); glProgramUniform1uiv(to, target, 1, u); break;
+                case GL_UNSIGNED_INT_VEC2: glGetUniformuiv(from, source, u); glProgramUniform2uiv(to, target, 1, u); break;
+                case GL_UNSIGNED_INT_VEC3: glGetUniformuiv(from, source, u); glProgramUniform3uiv(to, target, 1, u); break;
+                case GL_UNSIGNED_INT_VEC4: glGetUniformuiv(from, source, u); glProgramUniform4uiv(to, target, 1, u); break;
+                case GL_DOUBLE:
+                case GL_DOUBLE_VEC2:
+                case GL_DOUBLE_VEC3:
+                case GL_DOUBLE_VEC4:
+                case GL_DOUBLE_MAT2:
+                case GL_DOUBLE_MAT3:
+                case GL_DOUBLE_MAT4:
+                case GL_DOUBLE_MAT2x3:
+                case GL_DOUBLE_MAT2x4:
+                case GL_DOUBLE_MAT3x2:
+                case GL_DOUBLE_MAT3x4:
+                case GL_DOUBLE_MAT4x2:
+                case GL_DOUBLE_MAT4x3:
+                    break;
+                // int, bool and every sampler or image type hold a single integer
+                default:                   glGetUniformiv(from, source, n); glProgramUniform1iv(to, target, 1, n); break;
+                }
+            }
+        }
+    }
+}
+
+void Shader::swapProgram(unsigned int program)
+{
+    copyUniformValues(ID, program);
+
+    // Still fine if the old program is bound, GL deletes it once nothing uses it anymore
+    glDeleteProgram(ID);
+    ID = program;
+
+    // Leaves every shadow slot unknown, the copied values are not tracked
+    reflect();
+}
+
+namespace
+{
+    std::size_t uniformTypeSize(GLenum type)
+    {
+        switch (type)
+        {
+        case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: case GL_BOOL_VEC2:
+            return 8;
+        case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: case GL_BOOL_VEC3:
+            return 12;
+        case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: case GL_BOOL_VEC4:
+        case GL_FLOAT_MAT2: case GL_DOUBLE_VEC2:
+            return 16;
+        case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT3x2: case GL_DOUBLE_VEC3:
+            return 24;
+        case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT4x2: case GL_DOUBLE_VEC4: case GL_DOUBLE_MAT2:
+            return 32;
+        case GL_FLOAT_MAT3:
+            return 36;
+        case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x3: case GL_DOUBLE_MAT2x3: case GL_DOUBLE_MAT3x2:
+            return 48;
+        case GL_FLOAT_MAT4: case GL_DOUBLE_MAT2x4: case GL_DOUBLE_MAT4x2:
+            return 64;
+        case GL_DOUBLE_MAT3:
+            return 72;
+        case GL_DOUBLE_MAT3x4: case GL_DOUBLE_MAT4x3:
+            return 96;
+        case GL_DOUBLE_MAT4:
+            return 128;
+        case GL_DOUBLE:
+            return 8;
+        default:    // float, int, uint, bool, samplers and images
+            return 4;
+        }
+    }
+}
+
+UniformStats Shader::frameStats;
+
+// Builds the uniform and block tables through the program interface query API, the name hash
+// table used by the handles, and an empty shadow slot for every location
+void Shader::reflect()
+{
+    uniforms.clear();
+    blocks.clear();
+    uniformLocations.clear();
+    shadowSlots.clear();
+    shadow.clear();
+
+    int count = 0;
+    glGetProgramInterfaceiv(ID, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+
+    const GLenum properties[] = { GL_NAME_LENGTH, GL_TYPE, GL_LOCATION, GL_BLOCK_INDEX, GL_OFFSET, GL_ARRAY_SIZE };
+    for (int i = 0; i < count; i++)
+    {
+        int values[6];
+        glGetProgramResourceiv(ID, GL_UNIFORM, i, 6, properties, 6, NULL, values);
+
+        std::string name(values[0] > 0 ? values[0] : 1, '\0');
+        glGetProgramResourceName(ID, GL_UNIFORM, i, values[0], NULL, &name[0]);
+        name.resize(name.find('\0') == std::string::npos ? name.size() : name.find('\0'));
+
+        ShaderUniform uniform = { name, (GLenum)values[1], values[2], values[3], values[3] >= 0 ? values[4] : -1, values[5] };
+        uniforms.push_back(uniform);
+
+        if (uniform.location < 0)
+            continue;   // uniform block member
+
+        // Arrays report "name[0]", every element and the plain name get an entry
+        std::string base = name.substr(0, name.find('['));
+        std::size_t elementSize = uniformTypeSize(uniform.type);
+        for (int element = 0; element < uniform.arraySize; element++)
+        {
+            std::string elementName = name.find('[') == std::string::npos ? base : base + "[" + std::to_string(element) + "]";
+            int elementLocation = element == 0 ? uniform.location : glGetProgramResourceLocation(ID, GL_UNIFORM, elementName.c_str());
+            if (elementLocation < 0)
+                continue;
+
+            auto inserted = uniformLocations.emplace(uniformHash(elementName.c_str()), elementLocation);
+            if (!inserted.second && inserted.first->second != elementLocation)
+                std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION " << elementName << std::endl;
+            if (element == 0 && elementName != base)
+                uniformLocations.emplace(uniformHash(base.c_str()), elementLocation);
+
+            if (elementLocation >= (int)shadowSlots.size())
+                shadowSlots.resize(elementLocation + 1, ShadowSlot{ 0, 0, false });
+            shadowSlots[elementLocation] = ShadowSlot{ shadow.size(), elementSize, false };
+            shadow.resize(shadow.size() + elementSize);
+        }
+    }
+
+    glGetProgramInterfaceiv(ID, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &count);
+
+    const GLenum blockProperties[] = { GL_NAME_LENGTH, GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE, GL_NUM_ACTIVE_VARIABLES };
+    for (int i = 0; i < count; i++)
+    {
+        int values[4];
+        glGetProgramResourceiv(ID, GL_UNIFORM_BLOCK, i, 4, blockProperties, 4, NULL, values);
+
+        std::string name(values[0] > 0 ? values[0] : 1, '\0');
+        glGetProgramResourceName(ID, GL_UNIFORM_BLOCK, i, values[0], NULL, &name[0]);
+        name.resize(name.find('\0') == std::string::npos ? name.size() : name.find('\0'));
+
+        ShaderBlock block = { name, values[1], values[2], values[3] };
+        blocks.push_back(block);
+    }
+}
+
+int Shader::location(std::uint32_t nameHash) const
+{
+    auto it = uniformLocations.find(nameHash);
+    return it != uniformLocations.end() ? it->second : -1;
+}
+
+// Compares against the shadow copy and records the new value, false means the call can be skipped
+bool Shader::changed(int location, const void* data, std::size_t size) const
+{
+    if (location < 0)
+        return false;
+
+    if (location < (int)shadowSlots.size() && shadowSlots[location].size)
+    {
+        ShadowSlot& slot = shadowSlots[location];
+        unsigned char* current = &shadow[slot.offset];
+
+        if (slot.valid && std::memcmp(current, data, size) == 0)
+        {
+            frameStats.elided++;
+            return false;
+        }
+
+        // A setter that does not match the declared type writes through and forgets the value
+        slot.valid = size == slot.size;
+        if (slot.valid)
+            std::memcpy(current, data, size);
+    }
+
+    frameStats.issued++;
+    return true;
+}
+
+void Shader::set(Uniform<bool> uniform, bool value) const
+{
+    int data = (int)value;
+    if (changed(uniform.location, &data, sizeof(data)))
+        glProgramUniform1i(ID, uniform.location, data);
+}
+void Shader::set(Uniform<int> uniform, int value) const
+{
+    if (changed(uniform.location, &value, sizeof(value)))
+        glProgramUniform1i(ID, uniform.location, value);
+}
+void Shader::set(Uniform<float> uniform, float value) const
+{
+    if (changed(uniform.location, &value, sizeof(value)))
+        glProgramUniform1f(ID, uniform.location, value);
+}
+void Shader::set(Uniform<glm::ivec2> uniform, const glm::ivec2 &value) const
+{
+    const int data[2] = { value.x, value.y };
+    if (changed(uniform.location, data, sizeof(data)))
+        glProgramUniform2iv(ID, uniform.location, 1, data);
+}
+void Shader::set(Uniform<glm::vec2> uniform, const glm::vec2 &value) const
+{
+    if (changed(uniform.location, &value[0], sizeof(float) * 2))
+        glProgramUniform2fv(ID, uniform.location, 1, &value[0]);
+}
+void Shader::set(Uniform<glm::vec3> uniform, const glm::vec3 &value) const
+{
+    if (changed(uniform.location, &value[0], sizeof(float) * 3))
+        glProgramUniform3fv(ID, uniform.location, 1, &value[0]);
+}
+void Shader::set(Uniform<glm::vec4> uniform, const glm::vec4 &value) const
+{
+    if (changed(uniform.location, &value[0], sizeof(float) * 4))
+        glProgramUniform4fv(ID, uniform.location, 1, &value[0]);
+}
+void Shader::set(Uniform<glm::mat2> uniform, const glm::mat2 &mat) const
+{
+    if (changed(uniform.location, &mat[0][0], sizeof(float) * 4))
+        glProgramUniformMatrix2fv(ID, uniform.location, 1, GL_FALSE, &mat[0][0]);
+}
+void Shader::set(Uniform<glm::mat3> uniform, const glm::mat3 &mat) const
+{
+    if (changed(uniform.location, &mat[0][0], sizeof(float) * 9))
+        glProgramUniformMatrix3fv(ID, uniform.location, 1, GL_FALSE, &mat[0][0]);
+}
+void Shader::set(Uniform<glm::mat4> uniform, const glm::mat4 &mat) const
+{
+    if (changed(uniform.location, &mat[0][0], sizeof(float) * 16))
+        glProgramUniformMatrix4fv(ID, uniform.location, 1, GL_FALSE, &mat[0][0]);
+}
+
 void Shader::setBool(const std::string &name, bool value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    set(uniform<bool>(uniformHash(name.c_str())), value);
 }
 
 void Shader::setInt(const std::string &name, int value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    set(uniform<int>(uniformHash(name.c_str())), value);
 }
 
 void Shader::setFloat(const std::string &name, float value) const
 {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), (float)value);
+    set(uniform<float>(uniformHash(name.c_str())), value);
+}
+
+void Shader::setIVec2(const std::string &name, int x, int y) const
+{
+    set(uniform<glm::ivec2>(uniformHash(name.c_str())), glm::ivec2(x, y));
 }
 
 void Shader::setVec2(const std::string &name, const glm::vec2 &value) const
 {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    set(uniform<glm::vec2>(uniformHash(name.c_str())), value);
 }
 void Shader::setVec2(const std::string &name, float x, float y) const
 {
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+    set(uniform<glm::vec2>(uniformHash(name.c_str())), glm::vec2(x, y));
 }
 void Shader::setVec3(const std::string &name, const glm::vec3 &value) const
 {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    set(uniform<glm::vec3>(uniformHash(name.c_str())), value);
 }
 void Shader::setVec3(const std::string &name, float x, float y, float z) const
 {
-glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    set(uniform<glm::vec3>(uniformHash(name.c_str())), glm::vec3(x, y, z));
 }
 void Shader::setVec4(const std::string &name, const glm::vec4 &value) const
 {
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    set(uniform<glm::vec4>(uniformHash(name.c_str())), value);
 }
 void Shader::setVec4(const std::string &name, float x, float y, float z, float w) const
 {
-    glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+    set(uniform<glm::vec4>(uniformHash(name.c_str())), glm::vec4(x, y, z, w));
 }
 void Shader::setMat2(const std::string &name, const glm::mat2 &mat) const
 {
-    glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    set(uniform<glm::mat2>(uniformHash(name.c_str())), mat);
 }
 void Shader::setMat3(const std::string &name, const glm::mat3 &mat) const
 {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    set(uniform<glm::mat3>(uniformHash(name.c_str())), mat);
 }
 void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    set(uniform<glm::mat4>(uniformHash(name.c_str())), mat);
 }
 
-void Shader::checkCompileErrors(unsigned int shader, std::string type)
+bool Shader::checkCompileErrors(unsigned int shader, std::string type)
 {
     int success;
     char infoLog[1024];
@@ -140,5 +457,6 @@ void Shader::checkCompileErrors(unsigned int shader, std::string type)
             std::cout << "SHADER_LINKING::SUCCESS" << std::endl;
         }
     }
+    return success != 0;
 }
 
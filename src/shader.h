@@ -3,37 +3,102 @@
 #include <glad/glad.h> // include glad to get all the required OpenGL headers
 #include <glm/glm.hpp>
 
+#include <cstdint>
 #include <string>
-#include <fstream>
-#include <sstream>
-#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// FNV-1a of a uniform name, constexpr so names written as literals hash at compile time
+constexpr std::uint32_t uniformHash(const char* name, std::uint32_t hash = 2166136261u)
+{
+    return *name ? uniformHash(name + 1, (hash ^ (unsigned char)*name) * 16777619u) : hash;
+}
+
+// Location of a uniform resolved once after linking, typed so set() picks the right glProgramUniform call
+template<typename T>
+struct Uniform
+{
+    int location = -1;
+};
+
+// Post-link reflection of one active uniform
+struct ShaderUniform
+{
+    std::string name;
+    GLenum type;
+    int location;       // -1 for uniform block members
+    int blockIndex;     // -1 outside of uniform blocks
+    int offset;         // byte offset inside the block, -1 outside
+    int arraySize;
+};
+
+// Post-link reflection of one uniform block
+struct ShaderBlock
+{
+    std::string name;
+    int binding;
+    int dataSize;
+    int activeVariables;
+};
+
+// Uniform uploads that reached the driver and the ones dropped because nothing changed
+struct UniformStats
+{
+    unsigned int issued = 0;
+    unsigned int elided = 0;
+};
 
 class Shader
 {
 public:
     unsigned int ID;
 
-    std::string vertexCode;
-    std::string fragmentCode;
+    std::vector<ShaderUniform> uniforms;
+    std::vector<ShaderBlock> blocks;
 
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
+    // Summed over every Shader, the render loop resets it once per frame
+    static UniformStats frameStats;
 
-    std::stringstream vShaderStream;
-    std::stringstream fShaderStream;
+    // Sources go through ShaderSource and are released as soon as the program is linked. The defines
+    // are "#define NAME" lines, as ShaderVariants::defines builds them
+    Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = std::string());
 
-    const char* vShaderCode;
-    const char* fShaderCode;
+    // Takes over an already linked program
+    explicit Shader(unsigned int program);
 
-    unsigned int vertex;
-    unsigned int fragment;
+    void use();
 
-    Shader(const char* vertexPath, const char* fragmentPath);
+    // Replaces the program with a freshly linked one. Uniforms present in both keep their values,
+    // the old program is deleted and the reflection tables are rebuilt
+    void swapProgram(unsigned int program);
+
+    int location(std::uint32_t nameHash) const;
+    int location(const std::string &name) const { return location(uniformHash(name.c_str())); }
+
+    template<typename T>
+    Uniform<T> uniform(std::uint32_t nameHash) const
+    {
+        Uniform<T> handle;
+        handle.location = location(nameHash);
+        return handle;
+    }
+
+    // String free path for per draw uploads. Values identical to the last one written are dropped
+    void set(Uniform<bool> uniform, bool value) const;
+    void set(Uniform<int> uniform, int value) const;
+    void set(Uniform<float> uniform, float value) const;
+    void set(Uniform<glm::ivec2> uniform, const glm::ivec2 &value) const;
+    void set(Uniform<glm::vec2> uniform, const glm::vec2 &value) const;
+    void set(Uniform<glm::vec3> uniform, const glm::vec3 &value) const;
+    void set(Uniform<glm::vec4> uniform, const glm::vec4 &value) const;
+    void set(Uniform<glm::mat2> uniform, const glm::mat2 &mat) const;
+    void set(Uniform<glm::mat3> uniform, const glm::mat3 &mat) const;
+    void set(Uniform<glm::mat4> uniform, const glm::mat4 &mat) const;
 
-    void use();
     void setBool(const std::string &name, bool value) const;
     void setInt(const std::string &name, int value) const;
     void setFloat(const std::string &name, float value) const;
+    void setIVec2(const std::string &name, int x, int y) const;
     void setVec2(const std::string &name, const glm::vec2 &value) const;
     void setVec2(const std::string &name, float x, float y) const;
     void setVec3(const std::string &name, const glm::vec3 &value) const;
@@ -44,5 +109,20 @@ public:
     void setMat3(const std::string &name, const glm::mat3 &mat) const;
     void setMat4(const std::string &name, const glm::mat4 &mat) const;
 private:
-    void checkCompileErrors(unsigned int shader, std::string type);
+    // Active uniform locations keyed by uniformHash of their names, filled once after linking
+    std::unordered_map<std::uint32_t, int> uniformLocations;
+
+    // Last value written to each location, the slots start out unknown
+    struct ShadowSlot
+    {
+        std::size_t offset;
+        std::size_t size;
+        bool valid;
+    };
+    mutable std::vector<ShadowSlot> shadowSlots;
+    mutable std::vector<unsigned char> shadow;
+
+    void reflect();
+    bool changed(int location, const void* data, std::size_t size) const;
+    bool checkCompileErrors(unsigned int shader, std::string type);
 };
@@ -0,0 +1,323 @@
+#include "shader_compiler.h"
+#include "program_cache.h"
+#include "shader_source.h"
+
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace
+{
+    // Status and info log of a shader or program, only called once the work is known to be done
+    bool collectStatus(unsigned int object, bool program, const char* type, std::string& log)
+    {
+        int success = 0;
+        char infoLog[1024];
+
+        if (program)
+            glGetProgramiv(object, GL_LINK_STATUS, &success);
+        else
+            glGetShaderiv(object, GL_COMPILE_STATUS, &success);
+
+        if (!success)
+        {
+            if (program)
+                glGetProgramInfoLog(object, 1024, NULL, infoLog);
+            else
+                glGetShaderInfoLog(object, 1024, NULL, infoLog);
+
+            log += std::string(program ? "ERROR::PROGRAM_LINKING_ERROR of type: " : "ERROR::SHADER_COMPILATION_ERROR of type: ") + type + "\n" +
+                   infoLog + "\n -- --------------------------------------------------- -- \n";
+        }
+        return success != 0;
+    }
+}
+
+ShaderCompiler::ShaderCompiler(GLFWwindow* window)
+    : stopping(false)
+{
+    if (glfwExtensionSupported("GL_KHR_parallel_shader_compile") || glfwExtensionSupported("GL_ARB_parallel_shader_compile"))
+    {
+        typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+        MaxShaderCompilerThreadsProc maxThreads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+        if (!maxThreads)
+            maxThreads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+
+        // Let the driver pick how many threads it wants
+        if (maxThreads)
+            maxThreads(0xFFFFFFFFu);
+
+        parallelCompile = true;
+        std::cout << "SHADER_COMPILER::PARALLEL_SHADER_COMPILE" << std::endl;
+        return;
+    }
+
+    // Hidden 1x1 window whose context shares objects with the main one
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    workerWindow = glfwCreateWindow(1, 1, "", nullptr, window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+    if (workerWindow)
+    {
+        worker = std::thread(&ShaderCompiler::workerLoop, this);
+        std::cout << "SHADER_COMPILER::SHARED_CONTEXT_WORKER" << std::endl;
+    }
+    else
+    {
+        std::cout << "ERROR::SHADER_COMPILER::NO_SHARED_CONTEXT, compiling synchronously" << std::endl;
+    }
+}
+
+ShaderCompiler::~ShaderCompiler()
+{
+    if (workerWindow)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        worker.join();
+
+        glfwDestroyWindow(workerWindow);
+    }
+
+    // Builds nobody picked up yet, their objects are shared with the main context and freed here
+    for (const std::shared_ptr<Job>& job : pending)
+        discard(*job);
+}
+
+std::shared_ptr<ShaderBuild> ShaderCompiler::submit(const char* vertexPath, const char* fragmentPath, const std::string& defines)
+{
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->build = std::make_shared<ShaderBuild>();
+    job->build->vertexPath = vertexPath;
+    job->build->fragmentPath = fragmentPath;
+    job->build->defines = defines;
+
+    // Every define set ends up with its own binary cache entry since the key covers the final sources
+    if (!ShaderSource::load(vertexPath, defines, job->vertexCode) || !ShaderSource::load(fragmentPath, defines, job->fragmentCode))
+    {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ " << vertexPath << " " << fragmentPath << std::endl;
+        job->build->status = ShaderBuild::Failed;
+        return job->build;
+    }
+
+    // A cached binary is ready right away
+    job->cacheKey = ProgramCache::key(job->vertexCode, job->fragmentCode);
+    unsigned int program = glCreateProgram();
+    if (ProgramCache::load(program, job->cacheKey))
+    {
+        job->build->shader.reset(new Shader(program));
+        job->build->status = ShaderBuild::Ready;
+        return job->build;
+    }
+    glDeleteProgram(program);
+
+    if (parallelCompile)
+    {
+        compile(*job);
+    }
+    else if (workerWindow)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queued.push_back(job);
+        }
+        wake.notify_one();
+    }
+    else
+    {
+        compile(*job);
+        finish(*job);
+        return job->build;
+    }
+
+    pending.push_back(job);
+    return job->build;
+}
+
+// Issues the GL work without asking for any result, which would make the driver wait for it
+void ShaderCompiler::compile(Job& job) const
+{
+    const char* vShaderCode = job.vertexCode.c_str();
+    const char* fShaderCode = job.fragmentCode.c_str();
+
+    job.vertex = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(job.vertex, 1, &vShaderCode, NULL);
+    glCompileShader(job.vertex);
+
+    job.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(job.fragment, 1, &fShaderCode, NULL);
+    glCompileShader(job.fragment);
+
+    job.program = glCreateProgram();
+    glProgramParameteri(job.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glAttachShader(job.program, job.vertex);
+    glAttachShader(job.program, job.fragment);
+    glLinkProgram(job.program);
+
+    // The driver keeps its own copy from here on
+    std::string().swap(job.vertexCode);
+    std::string().swap(job.fragmentCode);
+}
+
+// Collects the results of a build that is known to be complete, on the main thread
+bool ShaderCompiler::finish(Job& job) const
+{
+    // The worker already did this in its own context
+    if (job.vertex)
+    {
+        collectStatus(job.vertex, false, "VERTEX", job.log);
+        collectStatus(job.fragment, false, "FRAGMENT", job.log);
+        job.linked = collectStatus(job.program, true, "PROGRAM", job.log);
+
+        glDeleteShader(job.vertex);
+        glDeleteShader(job.fragment);
+        job.vertex = 0;
+        job.fragment = 0;
+    }
+
+    ShaderBuild& build = *job.build;
+    if (!job.linked)
+    {
+        std::cout << job.log << build.vertexPath << " + " << build.fragmentPath << " failed to build" << std::endl;
+        glDeleteProgram(job.program);
+        build.status = ShaderBuild::Failed;
+        return false;
+    }
+
+    ProgramCache::store(job.program, job.cacheKey);
+
+    build.shader.reset(new Shader(job.program));
+    build.status = ShaderBuild::Ready;
+    std::cout << "SHADER_COMPILER::READY " << build.vertexPath << " + " << build.fragmentPath << std::endl;
+    return true;
+}
+
+// Frees whatever a job still holds. Names of 0, for jobs the worker never got to, are ignored by the GL
+void ShaderCompiler::discard(Job& job) const
+{
+    if (job.fence)
+        glDeleteSync(job.fence);
+    glDeleteShader(job.vertex);
+    glDeleteShader(job.fragment);
+    glDeleteProgram(job.program);
+
+    job.fence = nullptr;
+    job.vertex = 0;
+    job.fragment = 0;
+    job.program = 0;
+}
+
+bool ShaderCompiler::cancel(const std::shared_ptr<ShaderBuild>& build)
+{
+    for (const std::shared_ptr<Job>& job : pending)
+    {
+        // Still has to go through poll(), the worker may be compiling it right now
+        if (job->build == build && !job->cancelled)
+        {
+            job->cancelled = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+int ShaderCompiler::poll()
+{
+    int finished = 0;
+
+    for (auto it = pending.begin(); it != pending.end();)
+    {
+        Job& job = **it;
+        bool done = false;
+
+        if (parallelCompile)
+        {
+            int complete = 0;
+            glGetProgramiv(job.program, GL_COMPLETION_STATUS_KHR, &complete);
+            done = complete != 0;
+        }
+        else
+        {
+            GLsync fence;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                fence = job.fence;
+            }
+
+            // The fence makes the worker's program visible to this context
+            if (fence)
+            {
+                GLenum status = glClientWaitSync(fence, 0, 0);
+                done = status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+                if (done)
+                {
+                    glDeleteSync(fence);
+                    job.fence = nullptr;
+                }
+            }
+        }
+
+        if (done && job.cancelled)
+        {
+            discard(job);
+            it = pending.erase(it);
+        }
+        else if (done)
+        {
+            finish(job);
+            finished++;
+            it = pending.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    return finished;
+}
+
+void ShaderCompiler::workerLoop()
+{
+    glfwMakeContextCurrent(workerWindow);
+
+    for (;;)
+    {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !queued.empty(); });
+            if (stopping)
+                break;
+            job = queued.front();
+            queued.pop_front();
+        }
+
+        // Blocking on the status is fine here, nobody is waiting for this thread
+        compile(*job);
+        collectStatus(job->vertex, false, "VERTEX", job->log);
+        collectStatus(job->fragment, false, "FRAGMENT", job->log);
+        job->linked = collectStatus(job->program, true, "PROGRAM", job->log);
+
+        glDeleteShader(job->vertex);
+        glDeleteShader(job->fragment);
+        job->vertex = 0;
+        job->fragment = 0;
+
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        job->fence = fence;
+    }
+
+    glfwMakeContextCurrent(nullptr);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "shader.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct GLFWwindow;
+
+// One program going through the compiler. shader is only set once status is Ready
+struct ShaderBuild
+{
+    enum Status
+    {
+        Pending,
+        Ready,
+        Failed
+    };
+
+    std::string vertexPath;
+    std::string fragmentPath;
+
+    // Injected after the #version line of both stages
+    std::string defines;
+
+    Status status = Pending;
+    std::unique_ptr<Shader> shader;
+
+    bool ready() const { return status == Ready; }
+};
+
+// Builds programs without stalling the render loop. Everything is submitted first and poll()
+// picks up whatever finished. With GL_KHR_parallel_shader_compile the driver compiles on its own
+// threads and GL_COMPLETION_STATUS is polled, otherwise a worker thread with a shared context does it
+class ShaderCompiler
+{
+public:
+    explicit ShaderCompiler(GLFWwindow* window);
+    ~ShaderCompiler();
+
+    ShaderCompiler(const ShaderCompiler&) = delete;
+    ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+    std::shared_ptr<ShaderBuild> submit(const char* vertexPath, const char* fragmentPath, const std::string& defines = std::string());
+
+    // Never blocks, returns how many builds finished during this call
+    int poll();
+
+    // Drops a build that is still pending, for when a newer build replaces it. Its program is deleted
+    // once the compiler is done with it and the build itself is left alone. False when it already finished
+    bool cancel(const std::shared_ptr<ShaderBuild>& build);
+
+    bool busy() const { return !pending.empty(); }
+    bool parallel() const { return parallelCompile; }
+
+private:
+    struct Job
+    {
+        std::shared_ptr<ShaderBuild> build;
+        std::string vertexCode;
+        std::string fragmentCode;
+        std::uint64_t cacheKey;
+
+        unsigned int program = 0;
+        unsigned int vertex = 0;
+        unsigned int fragment = 0;
+
+        // Worker path only
+        bool linked = false;
+        std::string log;
+        GLsync fence = nullptr;
+
+        // Main thread only, see cancel()
+        bool cancelled = false;
+    };
+
+    void compile(Job& job) const;
+    bool finish(Job& job) const;
+    void discard(Job& job) const;
+    void workerLoop();
+
+    bool parallelCompile = false;
+    std::vector<std::shared_ptr<Job>> pending;
+
+    // Shared context fallback
+    GLFWwindow* workerWindow = nullptr;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::shared_ptr<Job>> queued;
+    std::atomic<bool> stopping;
+};
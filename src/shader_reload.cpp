@@ -0,0 +1,183 @@
+#include "shader_reload.h"
+
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    std::string directoryOf(const std::string& path)
+    {
+        std::size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? "." : path.substr(0, slash);
+    }
+
+    std::string fileOf(const std::string& path)
+    {
+        std::size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+}
+
+ShaderHotReload::ShaderHotReload(ShaderCompiler& compiler)
+    : compiler(compiler)
+{
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0)
+        std::cout << "ERROR::SHADER_HOT_RELOAD::INOTIFY_UNAVAILABLE" << std::endl;
+#else
+    std::cout << "SHADER_HOT_RELOAD::UNSUPPORTED_PLATFORM" << std::endl;
+#endif
+}
+
+ShaderHotReload::~ShaderHotReload()
+{
+#ifdef __linux__
+    if (inotifyFd >= 0)
+        close(inotifyFd);
+#endif
+}
+
+void ShaderHotReload::watch(const std::shared_ptr<ShaderBuild>& target, const std::string& vertexPath, const std::string& fragmentPath)
+{
+    Watch entry;
+    entry.target = target;
+    entry.vertexPath = vertexPath;
+    entry.fragmentPath = fragmentPath;
+    add(entry);
+}
+
+void ShaderHotReload::watch(Shader& target, const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines)
+{
+    Watch entry;
+    entry.shader = &target;
+    entry.defines = defines;
+    entry.vertexPath = vertexPath;
+    entry.fragmentPath = fragmentPath;
+    add(entry);
+}
+
+void ShaderHotReload::add(Watch entry)
+{
+    // Same spelling as the paths rebuilt from inotify events
+    entry.vertexPath = directoryOf(entry.vertexPath) + "/" + fileOf(entry.vertexPath);
+    entry.fragmentPath = directoryOf(entry.fragmentPath) + "/" + fileOf(entry.fragmentPath);
+    watches.push_back(entry);
+
+#ifdef __linux__
+    if (inotifyFd < 0)
+        return;
+
+    // Editors tend to save through a temporary file and a rename, so the directory is watched
+    // rather than the file itself
+    for (const std::string& path : { entry.vertexPath, entry.fragmentPath })
+    {
+        std::string directory = directoryOf(path);
+
+        bool known = false;
+        for (const Directory& watched : directories)
+            known = known || watched.path == directory;
+        if (known)
+            continue;
+
+        int wd = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (wd < 0)
+            std::cout << "ERROR::SHADER_HOT_RELOAD::CANNOT_WATCH " << directory << std::endl;
+        else
+            directories.push_back(Directory{ wd, directory });
+    }
+#endif
+}
+
+void ShaderHotReload::markChanged(const std::string& path)
+{
+    bool root = false;
+    for (Watch& entry : watches)
+    {
+        if (entry.vertexPath == path || entry.fragmentPath == path)
+        {
+            entry.dirty = true;
+            root = true;
+        }
+    }
+
+    // Anything else ending in .glsl may be #included by any of them
+    if (!root && path.size() > 5 && path.compare(path.size() - 5, 5, ".glsl") == 0)
+        for (Watch& entry : watches)
+            entry.dirty = true;
+}
+
+int ShaderHotReload::poll()
+{
+    int swapped = 0;
+
+#ifdef __linux__
+    if (inotifyFd >= 0)
+    {
+        alignas(inotify_event) char buffer[4096];
+        for (;;)
+        {
+            ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+            if (length <= 0)
+                break;      // EAGAIN, nothing more this frame
+
+            for (char* cursor = buffer; cursor < buffer + length;)
+            {
+                const inotify_event* event = (const inotify_event*)cursor;
+                cursor += sizeof(inotify_event) + event->len;
+
+                if (!event->len)
+                    continue;
+
+                for (const Directory& directory : directories)
+                    if (directory.wd == event->wd)
+                        markChanged(directory.path + "/" + event->name);
+            }
+        }
+    }
+#endif
+
+    for (Watch& entry : watches)
+    {
+        // Several saves in a row only rebuild once the previous rebuild is out of the way
+        if (entry.dirty && !entry.rebuild)
+        {
+            entry.dirty = false;
+            entry.rebuild = compiler.submit(entry.vertexPath.c_str(), entry.fragmentPath.c_str(), entry.target ? entry.target->defines : entry.defines);
+            std::cout << "SHADER_HOT_RELOAD::REBUILDING " << fileOf(entry.vertexPath) << " + " << fileOf(entry.fragmentPath) << std::endl;
+        }
+
+        if (!entry.rebuild || entry.rebuild->status == ShaderBuild::Pending)
+            continue;
+
+        // A failed build keeps the old program running, the compiler already printed the log
+        if (entry.rebuild->ready())
+        {
+            if (entry.shader)
+            {
+                entry.shader->swapProgram(entry.rebuild->shader->ID);
+            }
+            else if (entry.target->shader)
+            {
+                entry.target->shader->swapProgram(entry.rebuild->shader->ID);
+            }
+            else
+            {
+                // The original build is older than the rebuild, it must not land on top of it later
+                compiler.cancel(entry.target);
+                entry.target->shader = std::move(entry.rebuild->shader);
+                entry.target->status = ShaderBuild::Ready;
+            }
+            std::cout << "SHADER_HOT_RELOAD::SWAPPED " << fileOf(entry.vertexPath) << " + " << fileOf(entry.fragmentPath) << std::endl;
+            swapped++;
+        }
+
+        entry.rebuild.reset();
+    }
+
+    return swapped;
+}
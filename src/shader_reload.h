@@ -0,0 +1,62 @@
+#pragma once
+
+#include "shader_compiler.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Watches shader sources with inotify and rebuilds the programs using them through the
+// asynchronous compiler. The new program only replaces the old one once it linked, carrying
+// the uniform values over, so a typo in a shader never takes the running scene down. Only
+// vertex/fragment pairs, the downsampler's compute programs are built once at texture load.
+// Does nothing on platforms without inotify
+class ShaderHotReload
+{
+public:
+    explicit ShaderHotReload(ShaderCompiler& compiler);
+    ~ShaderHotReload();
+
+    ShaderHotReload(const ShaderHotReload&) = delete;
+    ShaderHotReload& operator=(const ShaderHotReload&) = delete;
+
+    // target is updated in place, it may still be compiling when the first change comes in.
+    // Rebuilds keep the defines of the target
+    void watch(const std::shared_ptr<ShaderBuild>& target, const std::string& vertexPath, const std::string& fragmentPath);
+
+    // For programs built directly through the Shader constructor. The shader has to outlive the watcher
+    void watch(Shader& target, const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines = std::string());
+
+    // Never blocks, call once per frame after ShaderCompiler::poll. Returns how many programs were swapped
+    int poll();
+
+private:
+    struct Watch
+    {
+        // One of the two is set
+        std::shared_ptr<ShaderBuild> target;
+        Shader* shader = nullptr;
+        std::string defines;
+
+        std::string vertexPath;
+        std::string fragmentPath;
+
+        std::shared_ptr<ShaderBuild> rebuild;
+        bool dirty = false;
+    };
+
+    struct Directory
+    {
+        int wd;
+        std::string path;
+    };
+
+    void add(Watch entry);
+    void markChanged(const std::string& path);
+
+    ShaderCompiler& compiler;
+    std::vector<Watch> watches;
+    std::vector<Directory> directories;
+
+    int inotifyFd = -1;
+};
@@ -0,0 +1,268 @@
+#include "shader_source.h"
+
+#include <sys/stat.h>
+
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <sstream>
+#endif
+
+namespace
+{
+    struct Dependency
+    {
+        std::string path;
+        long long modified;     // nanoseconds where the platform has them
+        long long size;
+    };
+
+    struct Entry
+    {
+        std::string code;
+        std::vector<Dependency> dependencies;
+    };
+
+    // Keyed by path and defines as written, a hash alone could hand out another shader's source
+    std::unordered_map<std::string, Entry> cache;
+    std::size_t cacheBytes = 0;
+
+    // A few dozen expanded shaders, lazy variants and hot reloads keep adding to it after startup
+    const std::size_t MAX_CACHE_BYTES = 1 << 20;
+
+    bool statFile(const std::string& path, Dependency& dependency)
+    {
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0)
+            return false;
+
+        // Whole seconds would miss two saves of the same size within one second
+        dependency.path = path;
+#if defined(__APPLE__)
+        dependency.modified = (long long)info.st_mtimespec.tv_sec * 1000000000ll + info.st_mtimespec.tv_nsec;
+#elif defined(__unix__)
+        dependency.modified = (long long)info.st_mtim.tv_sec * 1000000000ll + info.st_mtim.tv_nsec;
+#else
+        dependency.modified = (long long)info.st_mtime;
+#endif
+        dependency.size = (long long)info.st_size;
+        return true;
+    }
+
+    std::string directoryOf(const std::string& path)
+    {
+        std::size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+
+    // Replaces comments with spaces, newlines inside block comments are kept so line numbers hold
+    std::string stripComments(const std::string& code)
+    {
+        std::string out;
+        out.reserve(code.size());
+
+        std::size_t i = 0;
+        while (i < code.size())
+        {
+            if (code[i] == '/' && i + 1 < code.size() && code[i + 1] == '/')
+            {
+                while (i < code.size() && code[i] != '\n')
+                    i++;
+            }
+            else if (code[i] == '/' && i + 1 < code.size() && code[i + 1] == '*')
+            {
+                out += ' ';
+                i += 2;
+                while (i < code.size() && !(code[i] == '*' && i + 1 < code.size() && code[i + 1] == '/'))
+                {
+                    if (code[i] == '\n')
+                        out += '\n';
+                    i++;
+                }
+                i += 2;
+            }
+            else
+            {
+                out += code[i++];
+            }
+        }
+        return out;
+    }
+
+    // Name between the quotes or angle brackets of an #include line, empty for any other line
+    std::string includeTarget(const std::string& line)
+    {
+        std::size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 1, "#") != 0)
+            return std::string();
+
+        std::size_t directive = line.find_first_not_of(" \t", start + 1);
+        if (directive == std::string::npos || line.compare(directive, 7, "include") != 0)
+            return std::string();
+
+        std::size_t open = line.find_first_of("\"<", directive + 7);
+        if (open == std::string::npos)
+            return std::string();
+
+        std::size_t close = line.find(line[open] == '"' ? '"' : '>', open + 1);
+        return close == std::string::npos ? std::string() : line.substr(open + 1, close - open - 1);
+    }
+
+    bool expand(const std::string& path, const std::string& defines, std::string& out, std::vector<Dependency>& dependencies)
+    {
+        for (const Dependency& dependency : dependencies)
+            if (dependency.path == path)
+                return true;    // already included
+
+        Dependency dependency;
+        std::string raw;
+        if (!statFile(path, dependency) || !ShaderSource::readFile(path, raw))
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ " << path << std::endl;
+            return false;
+        }
+
+        // The position in the include order is the source string number in error messages
+        int fileIndex = (int)dependencies.size();
+        dependencies.push_back(dependency);
+
+        std::string code = stripComments(raw);
+        raw.clear();
+
+        if (fileIndex > 0)
+            out += "#line 1 " + std::to_string(fileIndex) + "\n";
+
+        int lineNumber = 1;
+        std::size_t begin = 0;
+        while (begin < code.size())
+        {
+            std::size_t end = code.find('\n', begin);
+            if (end == std::string::npos)
+                end = code.size();
+            std::string line = code.substr(begin, end - begin);
+            begin = end + 1;
+
+            std::string target = includeTarget(line);
+            if (!target.empty())
+            {
+                if (!expand(directoryOf(path) + target, std::string(), out, dependencies))
+                    return false;
+                out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+            }
+            else
+            {
+                out += line;
+                out += '\n';
+            }
+
+            // Only the root file has a #version line and nothing may come before it
+            if (!defines.empty() && fileIndex == 0 && line.find("#version") != std::string::npos)
+            {
+                out += defines;
+                out += "#line " + std::to_string(lineNumber + 1) + " 0\n";
+            }
+
+            lineNumber++;
+        }
+        return true;
+    }
+}
+
+bool ShaderSource::readFile(const std::string& path, std::string& out)
+{
+#ifdef __unix__
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    out.resize((std::size_t)info.st_size);
+
+    // One read for the whole file, the loop only matters for interrupted or short reads
+    std::size_t done = 0;
+    while (done < out.size())
+    {
+        ssize_t count = read(fd, &out[done], out.size() - done);
+        if (count <= 0)
+            break;
+        done += (std::size_t)count;
+    }
+    close(fd);
+
+    out.resize(done);
+    return done == (std::size_t)info.st_size;
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    std::stringstream stream;
+    stream << file.rdbuf();
+    out = stream.str();
+    return true;
+#endif
+}
+
+bool ShaderSource::load(const std::string& path, const std::string& defines, std::string& out)
+{
+    std::string key = path + '\n' + defines;
+
+    auto it = cache.find(key);
+    if (it != cache.end())
+    {
+        bool current = true;
+        for (const Dependency& cached : it->second.dependencies)
+        {
+            Dependency now;
+            current = current && statFile(cached.path, now) && now.modified == cached.modified && now.size == cached.size;
+        }
+
+        if (current)
+        {
+            out = it->second.code;
+            return true;
+        }
+    }
+
+    Entry entry;
+    if (!expand(path, defines, entry.code, entry.dependencies))
+        return false;
+
+    out = entry.code;
+
+    // Starting over is cheap next to a build, only the next few loads read their files again
+    if (it != cache.end())
+    {
+        cacheBytes -= it->second.code.size();
+        cache.erase(it);
+    }
+    if (cacheBytes + entry.code.size() > MAX_CACHE_BYTES)
+        clear();
+
+    cacheBytes += entry.code.size();
+    cache.emplace(std::move(key), std::move(entry));
+    return true;
+}
+
+void ShaderSource::clear()
+{
+    std::unordered_map<std::string, Entry>().swap(cache);
+    cacheBytes = 0;
+}
+
+std::size_t ShaderSource::cachedBytes()
+{
+    return cacheBytes;
+}
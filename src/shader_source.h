@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Turns shader files into the text handed to glShaderSource. Files are read with a single read
+// call, #include "file" is resolved relative to the including file (each file at most once),
+// comments are stripped and the defines go right after the #version line. Results are cached by
+// path and defines until one of the files involved changes on disk, judged by size and
+// modification time down to the nanosecond where the platform has it. The cache starts over once
+// it passes 1 MiB. Main thread only
+namespace ShaderSource
+{
+    bool readFile(const std::string& path, std::string& out);
+
+    bool load(const std::string& path, const std::string& defines, std::string& out);
+
+    // Drops every cached source, for example once the startup builds are linked. Later loads fill
+    // it again
+    void clear();
+
+    std::size_t cachedBytes();
+}
@@ -0,0 +1,75 @@
+#include "shader_variants.h"
+#include "shader_reload.h"
+
+#include <iostream>
+
+ShaderVariants::ShaderVariants(ShaderCompiler& compiler, const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& features)
+    : compiler(compiler), vertexPath(vertexPath), fragmentPath(fragmentPath), features(features)
+{
+    if (features.size() > 32)
+        std::cout << "ERROR::SHADER_VARIANTS::TOO_MANY_FEATURES " << features.size() << ", only the first 32 are usable" << std::endl;
+}
+
+std::uint32_t ShaderVariants::mask(const std::string& feature) const
+{
+    for (std::size_t i = 0; i < features.size() && i < 32; i++)
+        if (features[i] == feature)
+            return 1u << i;
+
+    std::cout << "ERROR::SHADER_VARIANTS::UNKNOWN_FEATURE " << feature << std::endl;
+    return 0;
+}
+
+std::string ShaderVariants::defines(std::uint32_t mask) const
+{
+    std::string code;
+    for (std::size_t i = 0; i < features.size() && i < 32; i++)
+        if (mask & (1u << i))
+            code += "#define " + features[i] + "\n";
+    return code;
+}
+
+void ShaderVariants::precompile(const std::vector<std::uint32_t>& masks)
+{
+    for (std::uint32_t mask : masks)
+        build(mask);
+
+    std::cout << "SHADER_VARIANTS::PRECOMPILE " << masks.size() << " variants of " << vertexPath << " + " << fragmentPath << std::endl;
+}
+
+Shader* ShaderVariants::get(std::uint32_t mask)
+{
+    const std::shared_ptr<ShaderBuild>& variant = build(mask);
+    return variant->ready() ? variant->shader.get() : nullptr;
+}
+
+const std::shared_ptr<ShaderBuild>& ShaderVariants::build(std::uint32_t mask)
+{
+    auto it = variants.find(mask);
+    if (it != variants.end())
+        return it->second;
+
+    // A cached binary comes back ready, anything else compiles off the render thread
+    std::shared_ptr<ShaderBuild>& variant = variants[mask];
+    variant = compiler.submit(vertexPath.c_str(), fragmentPath.c_str(), defines(mask));
+
+    if (hotReload)
+        watchVariant(variant);
+
+    return variant;
+}
+
+void ShaderVariants::watch(ShaderHotReload& hotReload, const std::string& watchVertexPath, const std::string& watchFragmentPath)
+{
+    this->hotReload = &hotReload;
+    this->watchVertexPath = watchVertexPath;
+    this->watchFragmentPath = watchFragmentPath;
+
+    for (auto& variant : variants)
+        watchVariant(variant.second);
+}
+
+void ShaderVariants::watchVariant(const std::shared_ptr<ShaderBuild>& variant)
+{
+    hotReload->watch(variant, watchVertexPath, watchFragmentPath);
+}
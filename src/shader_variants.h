@@ -0,0 +1,54 @@
+#pragma once
+
+#include "shader_compiler.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ShaderHotReload;
+
+// Feature variants of one vertex/fragment pair. Bit i of a mask adds "#define features[i]" to both
+// stages. A variant is compiled the first time something asks for it and kept by its mask, so only
+// the combinations that are actually used ever get built. precompile queues a known set up front,
+// the compiler works through it in the background while the first frames render
+class ShaderVariants
+{
+public:
+    ShaderVariants(ShaderCompiler& compiler, const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& features);
+
+    ShaderVariants(const ShaderVariants&) = delete;
+    ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+    // Bit of a declared feature, 0 for unknown names
+    std::uint32_t mask(const std::string& feature) const;
+
+    void precompile(const std::vector<std::uint32_t>& masks);
+
+    // Never blocks. nullptr until the variant linked, the caller draws with a fallback meanwhile
+    Shader* get(std::uint32_t mask);
+
+    const std::shared_ptr<ShaderBuild>& build(std::uint32_t mask);
+
+    // Every variant, present and future, gets rebuilt when these sources change
+    void watch(ShaderHotReload& hotReload, const std::string& watchVertexPath, const std::string& watchFragmentPath);
+
+    std::string defines(std::uint32_t mask) const;
+    std::size_t size() const { return variants.size(); }
+
+private:
+    void watchVariant(const std::shared_ptr<ShaderBuild>& variant);
+
+    ShaderCompiler& compiler;
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::vector<std::string> features;
+
+    std::unordered_map<std::uint32_t, std::shared_ptr<ShaderBuild>> variants;
+
+    ShaderHotReload* hotReload = nullptr;
+    std::string watchVertexPath;
+    std::string watchFragmentPath;
+};
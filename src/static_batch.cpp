@@ -0,0 +1,116 @@
+#include "static_batch.h"
+
+#include "geometry_pool.h"
+#include "meshlet.h"
+
+#include <cmath>
+#include <iostream>
+
+StaticBatcher::StaticBatcher(float chunkSize)
+    : chunkSize(chunkSize)
+{
+}
+
+void StaticBatcher::add(const MeshData& mesh, const glm::mat4& model, int material)
+{
+    if (mesh.vertices.empty())
+        return;
+
+    std::uint32_t firstIndex = mesh.lods.empty() ? 0 : mesh.lods[0].firstIndex;
+    std::uint32_t indexCount = mesh.lods.empty() ? std::uint32_t(mesh.indices.size()) : mesh.lods[0].indexCount;
+
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+    bool mirrored = glm::determinant(glm::mat3(model)) < 0.0f;
+
+    std::vector<Vertex> world(mesh.vertices.size());
+    glm::vec3 low(glm::vec3(model * glm::vec4(mesh.vertices[0].position, 1.0f)));
+    glm::vec3 high = low;
+    for (std::size_t i = 0; i < mesh.vertices.size(); i++)
+    {
+        world[i].position = glm::vec3(model * glm::vec4(mesh.vertices[i].position, 1.0f));
+        world[i].texCoord = mesh.vertices[i].texCoord;
+        world[i].normal = normalMatrix * mesh.vertices[i].normal;
+        if (glm::length(world[i].normal) > 0.0f)
+            world[i].normal = glm::normalize(world[i].normal);
+
+        low = glm::min(low, world[i].position);
+        high = glm::max(high, world[i].position);
+    }
+
+    // The whole instance goes to the cell of its center, chunks may overlap a little at the cell edges
+    glm::vec3 cell = glm::floor((low + high) * (0.5f / chunkSize));
+    Bucket& bucket = buckets[Key{ { material, int(cell.x), int(cell.y), int(cell.z) } }];
+
+    std::uint32_t baseVertex = std::uint32_t(bucket.mesh.vertices.size());
+    bucket.mesh.vertices.insert(bucket.mesh.vertices.end(), world.begin(), world.end());
+
+    // A mirroring transform turns counter-clockwise triangles clockwise, swapping two corners undoes it
+    for (std::uint32_t i = firstIndex; i + 2 < firstIndex + indexCount; i += 3)
+    {
+        bucket.mesh.indices.push_back(baseVertex + mesh.indices[i]);
+        bucket.mesh.indices.push_back(baseVertex + mesh.indices[mirrored ? i + 2 : i + 1]);
+        bucket.mesh.indices.push_back(baseVertex + mesh.indices[mirrored ? i + 1 : i + 2]);
+    }
+
+    bucket.instances++;
+}
+
+std::vector<StaticChunk> StaticBatcher::build(GeometryPool& pool, const std::string& name)
+{
+    std::vector<StaticChunk> chunks;
+    unsigned int instances = 0;
+    std::size_t triangles = 0;
+
+    for (auto& entry : buckets)
+    {
+        const Key& key = entry.first;
+        Bucket& bucket = entry.second;
+
+        // Same passes as a single mesh, the meshlets bring their own vertex cache order
+        MeshBuilder::optimizeMeshlets(bucket.mesh);
+        MeshBuilder::optimizeVertexFetch(bucket.mesh);
+
+        std::string chunkName = name + "[" + std::to_string(key[0]) + ": " + std::to_string(key[1]) + ", " + std::to_string(key[2]) + ", " + std::to_string(key[3]) + "]";
+        int mesh = pool.add(MeshBuilder::pack(bucket.mesh, chunkName));
+        if (mesh < 0)
+        {
+            std::cout << "ERROR::STATIC_BATCH::DROPPED " << chunkName << ", " << bucket.instances << " instances" << std::endl;
+            continue;
+        }
+
+        // Pool bounds are in the space the mesh was packed from, which is world space here
+        const PoolMesh& poolMesh = pool.mesh(mesh);
+        chunks.push_back(StaticChunk{ mesh, key[0], bucket.instances, poolMesh.center, poolMesh.radius });
+
+        instances += bucket.instances;
+        triangles += bucket.mesh.indices.size() / 3;
+    }
+
+    std::cout << "STATIC_BATCH::BUILT " << name << ": " << instances << " instances merged into " << chunks.size()
+              << " chunks, " << triangles << " triangles" << std::endl;
+
+    buckets.clear();
+    return chunks;
+}
+
+void StaticBatcher::cull(const std::vector<StaticChunk>& chunks, const glm::mat4& viewProj, std::vector<std::size_t>& visible)
+{
+    glm::vec4 planes[6];
+    MeshletCuller::frustumPlanes(viewProj, planes);
+
+    stats.chunks += (unsigned int)chunks.size();
+    for (std::size_t i = 0; i < chunks.size(); i++)
+    {
+        const StaticChunk& chunk = chunks[i];
+
+        bool inside = true;
+        for (const glm::vec4& plane : planes)
+            inside = inside && plane.x * chunk.center.x + plane.y * chunk.center.y + plane.z * chunk.center.z + plane.w > -chunk.radius;
+
+        if (inside)
+        {
+            visible.push_back(i);
+            stats.visible++;
+        }
+    }
+}
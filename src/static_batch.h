@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mesh.h"
+
+class GeometryPool;
+
+// Merged geometry of every static instance that shares a material and a chunk, already in world
+// space. It lives in the pool like any other mesh and is drawn with the decode matrix as its model
+struct StaticChunk
+{
+    int mesh;
+    int material;
+    unsigned int instances;
+
+    // World space bounding sphere of the merged vertices
+    glm::vec3 center;
+    float radius;
+};
+
+// Turns props that never move into a handful of meshes. Instances are transformed into world space
+// as they are added and sorted into buckets by material and by the grid cell their bounds center
+// falls into. build() optimizes each bucket as one mesh and adds it to the pool, so a chunk costs one
+// draw and one object entry however many instances went into it, and can still be frustum culled.
+// Only level 0 of the source meshes is copied, merged chunks have no coarser levels
+class StaticBatcher
+{
+public:
+    struct Stats
+    {
+        unsigned int chunks = 0;
+        unsigned int visible = 0;
+    };
+
+    // Reset by the caller, usually once per frame
+    Stats stats;
+
+    // Edge length of the grid cells, larger chunks mean fewer draws but coarser culling
+    explicit StaticBatcher(float chunkSize = 16.0f);
+
+    void add(const MeshData& mesh, const glm::mat4& model, int material);
+
+    // Every bucket becomes one mesh in the pool, the batcher is empty again afterwards. Chunks that do
+    // not fit anymore are reported and left out
+    std::vector<StaticChunk> build(GeometryPool& pool, const std::string& name);
+
+    // Indices into chunks of the ones intersecting the frustum
+    void cull(const std::vector<StaticChunk>& chunks, const glm::mat4& viewProj, std::vector<std::size_t>& visible);
+
+private:
+    // Material, then the cell coordinates
+    typedef std::array<int, 4> Key;
+
+    struct Bucket
+    {
+        MeshData mesh;
+        unsigned int instances = 0;
+    };
+
+    float chunkSize;
+    std::map<Key, Bucket> buckets;
+};
@@ -0,0 +1,92 @@
+#include "stream_buffer.h"
+#include "vertex_layout.h"
+
+#include <iostream>
+
+StreamBuffer::StreamBuffer(std::size_t frameSize, int frames)
+    : frames(frames < 1 ? 1 : frames > MAX_FRAMES ? MAX_FRAMES : frames)
+{
+    // Regions start on a 256 byte boundary so their contents can also be bound as uniform or storage ranges
+    regionSize = (frameSize + 255) / 256 * 256;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &ID);
+    glNamedBufferStorage(ID, regionSize * this->frames, nullptr, flags);
+    mapped = (unsigned char*)glMapNamedBufferRange(ID, 0, regionSize * this->frames, flags);
+
+    if (!mapped)
+        std::cerr << "ERROR::STREAM_BUFFER::MAP_FAILED" << std::endl;
+
+    for (int i = 0; i < MAX_FRAMES; i++)
+        fences[i] = nullptr;
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    for (int i = 0; i < MAX_FRAMES; i++)
+        if (fences[i])
+            glDeleteSync(fences[i]);
+
+    // Debug lines draw straight out of it through a vertex layout
+    VertexLayouts::forgetBuffer(ID);
+
+    glUnmapNamedBuffer(ID);
+    glDeleteBuffers(1, &ID);
+}
+
+void StreamBuffer::begin()
+{
+    GLsync& fence = fences[current];
+    if (fence)
+    {
+        // Polling first keeps the common case, a region that is long done, free of any flush
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+            stats.waits++;
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        }
+        if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+            std::cerr << "ERROR::STREAM_BUFFER::FENCE_WAIT_FAILED" << std::endl;
+
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    head = 0;
+    recording = true;
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(std::size_t size, std::size_t alignment)
+{
+    Allocation allocation = { nullptr, 0 };
+    if (!recording || !mapped || size == 0)
+        return allocation;
+
+    // Aligned against the whole buffer rather than the region, strides do not have to divide 256
+    std::size_t base = regionSize * current;
+    std::size_t offset = alignment > 1 ? (base + head + alignment - 1) / alignment * alignment : base + head;
+    if (offset + size > base + regionSize)
+    {
+        stats.overflows++;
+        return allocation;
+    }
+
+    head = offset + size - base;
+    stats.bytes += size;
+    stats.allocations++;
+
+    allocation.data = mapped + offset;
+    allocation.offset = offset;
+    return allocation;
+}
+
+void StreamBuffer::end()
+{
+    if (!recording)
+        return;
+
+    fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    current = (current + 1) % frames;
+    recording = false;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// Buffer for geometry rewritten every frame (debug lines, particles, UI). Storage is immutable and
+// persistently mapped, split into one region per frame in flight. Allocations are bumped out of the
+// current region and written in place, a fence per region keeps the CPU off memory the GPU still
+// reads. Nothing is orphaned or copied and the driver never has to synchronize on its own
+class StreamBuffer
+{
+public:
+    static const int MAX_FRAMES = 4;
+
+    struct Allocation
+    {
+        void* data;             // nullptr when the region is full
+        std::size_t offset;     // from the start of the buffer, bind ID at 0 and use it as is
+    };
+
+    struct Stats
+    {
+        std::size_t bytes = 0;          // handed out since the last reset
+        unsigned int allocations = 0;
+        unsigned int overflows = 0;     // requests that did not fit into their region
+        unsigned int waits = 0;         // frames that had to wait on their region's fence
+    };
+
+    unsigned int ID;
+
+    // Reset by the caller, usually once per frame
+    Stats stats;
+
+    explicit StreamBuffer(std::size_t frameSize, int frames = 3);
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // Starts writing into the next region, only waits if the GPU is more than `frames` frames behind
+    void begin();
+
+    // Offsets are aligned within the buffer, so a vertex stride as alignment makes offset / stride a valid first vertex
+    Allocation allocate(std::size_t size, std::size_t alignment = 16);
+
+    template<typename T>
+    T* allocate(std::size_t count, std::size_t* offset)
+    {
+        Allocation allocation = allocate(count * sizeof(T), sizeof(T));
+        *offset = allocation.offset;
+        return static_cast<T*>(allocation.data);
+    }
+
+    // Call once every draw reading the current region has been issued
+    void end();
+
+    std::size_t frameSize() const { return regionSize; }
+
+private:
+    unsigned char* mapped;
+
+    std::size_t regionSize;
+    int frames;
+    int current = 0;
+    std::size_t head = 0;
+    bool recording = false;
+
+    GLsync fences[MAX_FRAMES];
+};
@@ -0,0 +1,190 @@
+#include "texture.h"
+#include "downsampler.h"
+#include "stb_image.h"
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    std::string canonicalPath(const std::string& path)
+    {
+#ifdef _WIN32
+        char resolved[_MAX_PATH];
+        if (_fullpath(resolved, path.c_str(), _MAX_PATH))
+            return resolved;
+#else
+        char resolved[PATH_MAX];
+        if (realpath(path.c_str(), resolved))
+            return resolved;
+#endif
+        return path;
+    }
+
+    bool readFile(const std::string& path, std::vector<unsigned char>& out)
+    {
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+
+        std::fseek(file, 0, SEEK_END);
+        long length = std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+
+        out.resize(length > 0 ? (std::size_t)length : 0);
+        bool ok = length > 0 && std::fread(out.data(), 1, out.size(), file) == out.size();
+        std::fclose(file);
+        return ok;
+    }
+
+    // FNV-1a, good enough to tell image files apart
+    std::uint64_t hashBytes(const unsigned char* data, std::size_t size)
+    {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (std::size_t i = 0; i < size; i++)
+        {
+            hash ^= data[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    int mipLevels(int width, int height)
+    {
+        int levels = 1;
+        while ((width | height) >> levels)
+            levels++;
+        return levels;
+    }
+}
+
+Texture::Texture(const unsigned char* pixels, int width, int height, Downsampler* downsampler)
+    : width(width), height(height), levels(mipLevels(width, height)), gpuBytes(0), contentHash(0), flipped(false)
+{
+    // Immutable RGBA8 storage with a full mip chain
+    glCreateTextures(GL_TEXTURE_2D, 1, &ID);
+    glTextureStorage2D(ID, levels, GL_RGBA8, width, height);
+    glTextureSubImage2D(ID, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+    // Wrapping and filtering come from the sampler bound next to the texture, see SamplerCache
+    if (downsampler)
+        downsampler->generate(ID);
+    else
+        glGenerateTextureMipmap(ID);
+
+    for (int level = 0; level < levels; level++)
+    {
+        std::size_t w = width >> level ? width >> level : 1;
+        std::size_t h = height >> level ? height >> level : 1;
+        gpuBytes += w * h * 4;
+    }
+}
+
+Texture::~Texture()
+{
+    glDeleteTextures(1, &ID);
+}
+
+TextureHandle TextureRegistry::load(const std::string& path)
+{
+    loads++;
+
+    std::string canonical = canonicalPath(path);
+    std::string pathKey = (flipVertically ? "flipped:" : "") + canonical;
+
+    auto pathIt = byPath.find(pathKey);
+    if (pathIt != byPath.end())
+    {
+        if (TextureHandle texture = pathIt->second.lock())
+        {
+            hits++;
+            return texture;
+        }
+    }
+
+    std::vector<unsigned char> bytes;
+    if (!readFile(canonical, bytes))
+    {
+        std::cerr << "Texture loading failed: " << path << std::endl;
+        return nullptr;
+    }
+
+    // Same contents under another name, only remember the new path. The hash only narrows it
+    // down, the bytes of the file behind the existing texture have to match as well
+    std::uint64_t hash = hashBytes(bytes.data(), bytes.size());
+    auto range = byHash.equal_range(hash);
+    for (auto hashIt = range.first; hashIt != range.second; ++hashIt)
+    {
+        TextureHandle texture = hashIt->second.lock();
+        std::vector<unsigned char> existing;
+        if (!texture || texture->flipped != flipVertically || !readFile(texture->path, existing) || existing != bytes)
+            continue;
+
+        hits++;
+        byPath[pathKey] = texture;
+        return texture;
+    }
+
+    int width;
+    int height;
+    int nrChannels;
+
+    stbi_set_flip_vertically_on_load(flipVertically);
+    unsigned char* image = stbi_load_from_memory(bytes.data(), (int)bytes.size(), &width, &height, &nrChannels, 4);
+    if (!image)
+    {
+        std::cerr << "Texture loading failed: " << path << std::endl;
+        return nullptr;
+    }
+
+    TextureHandle texture = std::make_shared<Texture>(image, width, height, downsampler);
+    texture->contentHash = hash;
+    texture->path = canonical;
+    texture->flipped = flipVertically;
+
+    stbi_image_free(image);
+
+    byPath[pathKey] = texture;
+    byHash.insert(std::make_pair(hash, std::weak_ptr<Texture>(texture)));
+
+    return texture;
+}
+
+std::size_t TextureRegistry::size() const
+{
+    std::size_t count = 0;
+    for (const auto& entry : byHash)
+        if (!entry.second.expired())
+            count++;
+    return count;
+}
+
+std::size_t TextureRegistry::gpuBytes() const
+{
+    std::size_t bytes = 0;
+    for (const auto& entry : byHash)
+        if (TextureHandle texture = entry.second.lock())
+            bytes += texture->gpuBytes;
+    return bytes;
+}
+
+// Forgets the entries whose textures have already been released
+void TextureRegistry::collect()
+{
+    for (auto it = byPath.begin(); it != byPath.end();)
+        it = it->second.expired() ? byPath.erase(it) : std::next(it);
+
+    for (auto it = byHash.begin(); it != byHash.end();)
+        it = it->second.expired() ? byHash.erase(it) : std::next(it);
+}
+
+void TextureRegistry::printStats() const
+{
+    std::cout << "TEXTURES: " << size() << " resident, " << gpuBytes() / 1024 << " KiB, "
+              << hits << "/" << loads << " loads deduplicated" << std::endl;
+}
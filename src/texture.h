@@ -0,0 +1,66 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+class Downsampler;
+
+// A single GPU texture. The GL name is released as soon as the last handle goes away
+class Texture
+{
+public:
+    unsigned int ID;
+
+    int width;
+    int height;
+    int levels;
+
+    std::size_t gpuBytes;
+    std::uint64_t contentHash;
+    std::string path;
+    bool flipped;
+
+    // The mip chain comes from the downsampler when one is given, from glGenerateTextureMipmap otherwise
+    Texture(const unsigned char* pixels, int width, int height, Downsampler* downsampler = nullptr);
+    ~Texture();
+
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
+};
+
+typedef std::shared_ptr<Texture> TextureHandle;
+
+// Loads every image at most once. Lookups go through the canonical path first and then
+// through a hash of the file contents, so copies of the same image under different names
+// also share one upload. A hash hit is confirmed against the bytes of the file already loaded.
+// The registry only keeps weak references, ownership stays with the handles
+class TextureRegistry
+{
+public:
+    // Passed on to every Texture, which then builds its mips with it instead of glGenerateTextureMipmap
+    Downsampler* downsampler = nullptr;
+
+    // Bottom row first, as GL expects. Applied to stb_image on every load and part of the lookup,
+    // so the same file loaded both ways gives two textures
+    bool flipVertically = false;
+
+    TextureHandle load(const std::string& path);
+
+    std::size_t size() const;
+    std::size_t gpuBytes() const;
+
+    void collect();
+    void printStats() const;
+
+private:
+    std::unordered_map<std::string, std::weak_ptr<Texture>> byPath;
+    std::unordered_multimap<std::uint64_t, std::weak_ptr<Texture>> byHash;
+
+    unsigned int loads = 0;
+    unsigned int hits = 0;
+};
@@ -0,0 +1,63 @@
+#include "uniform_ring.h"
+
+#include "gl_state.h"
+
+#include <iostream>
+
+UniformRing::UniformRing(std::size_t blockSize, int frames)
+    : blockSize(blockSize), frames(frames < 1 ? 1 : frames > MAX_FRAMES ? MAX_FRAMES : frames)
+{
+    // Every region has to start on the offset alignment glBindBufferRange asks for
+    int alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    stride = (blockSize + alignment - 1) / alignment * alignment;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, stride * this->frames, nullptr, flags);
+    mapped = (unsigned char*)glMapNamedBufferRange(buffer, 0, stride * this->frames, flags);
+
+    if (!mapped)
+        std::cerr << "ERROR::UNIFORM_RING::MAP_FAILED" << std::endl;
+
+    for (int i = 0; i < MAX_FRAMES; i++)
+        fences[i] = nullptr;
+}
+
+UniformRing::~UniformRing()
+{
+    for (int i = 0; i < MAX_FRAMES; i++)
+        if (fences[i])
+            glDeleteSync(fences[i]);
+
+    glUnmapNamedBuffer(buffer);
+    glDeleteBuffers(1, &buffer);
+}
+
+void* UniformRing::begin()
+{
+    GLsync& fence = fences[current];
+    if (fence)
+    {
+        // One second is far beyond any sane frame time, it is only there to avoid hanging forever
+        GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+            std::cerr << "ERROR::UNIFORM_RING::FENCE_WAIT_FAILED" << std::endl;
+
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    return mapped + stride * current;
+}
+
+void UniformRing::bind(GLStateCache& state, unsigned int binding) const
+{
+    state.bindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, GLintptr(stride * current), GLsizeiptr(blockSize));
+}
+
+void UniformRing::end()
+{
+    fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    current = (current + 1) % frames;
+}
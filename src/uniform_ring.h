@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+class GLStateCache;
+
+// A uniform buffer split into one region per frame in flight, persistently mapped so the CPU
+// writes straight into memory the GPU reads. A fence per region makes sure a region is only
+// rewritten once the frame that used it has finished
+class UniformRing
+{
+public:
+    static const int MAX_FRAMES = 4;
+
+    explicit UniformRing(std::size_t blockSize, int frames = 3);
+    ~UniformRing();
+
+    UniformRing(const UniformRing&) = delete;
+    UniformRing& operator=(const UniformRing&) = delete;
+
+    // Region for the current frame, only waits if the GPU is more than `frames` frames behind
+    void* begin();
+
+    template<typename T>
+    T* begin() { return static_cast<T*>(begin()); }
+
+    // Binds the current region as the whole uniform block at the given binding point
+    void bind(GLStateCache& state, unsigned int binding) const;
+
+    // Call once every draw reading the current region has been issued
+    void end();
+
+private:
+    unsigned int buffer;
+    unsigned char* mapped;
+
+    std::size_t blockSize;
+    std::size_t stride;
+    int frames;
+    int current = 0;
+
+    GLsync fences[MAX_FRAMES];
+};
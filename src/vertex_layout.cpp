@@ -0,0 +1,128 @@
+#include "vertex_layout.h"
+
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    struct LayoutEntry
+    {
+        std::vector<VertexAttribute> attributes;
+        GLuint divisor;
+        unsigned int vao;
+
+        // Last buffers handed to bindBuffers, a draw of the same mesh again changes nothing
+        unsigned int vertexBuffer;
+        GLintptr offset;
+        GLsizei stride;
+        unsigned int indexBuffer;
+    };
+
+    // A handful of formats at most, a linear search beats anything keyed
+    std::vector<LayoutEntry> layouts;
+    unsigned int released = 0;
+
+    bool sameFormat(const VertexAttribute& a, const VertexAttribute& b)
+    {
+        return a.location == b.location && a.components == b.components && a.type == b.type &&
+               a.normalized == b.normalized && a.integer == b.integer && a.bytes == b.bytes;
+    }
+}
+
+unsigned int VertexLayouts::vertexArray(const VertexAttribute* attributes, std::size_t count, GLuint divisor)
+{
+    // Compared by contents, two layout types describing the same format share a VAO as well. Only
+    // reached once per layout type, vao() keeps the result
+    for (const LayoutEntry& entry : layouts)
+    {
+        if (entry.divisor != divisor || entry.attributes.size() != count)
+            continue;
+
+        std::size_t i = 0;
+        while (i < count && sameFormat(entry.attributes[i], attributes[i]))
+            i++;
+        if (i == count)
+            return entry.vao;
+    }
+
+    LayoutEntry entry = { std::vector<VertexAttribute>(attributes, attributes + count), divisor, 0, 0, 0, 0, 0 };
+    glCreateVertexArrays(1, &entry.vao);
+    glVertexArrayBindingDivisor(entry.vao, 0, divisor);
+
+    GLuint offset = 0;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const VertexAttribute& attribute = attributes[i];
+        glEnableVertexArrayAttrib(entry.vao, attribute.location);
+        if (attribute.integer)
+            glVertexArrayAttribIFormat(entry.vao, attribute.location, attribute.components, attribute.type, offset);
+        else
+            glVertexArrayAttribFormat(entry.vao, attribute.location, attribute.components, attribute.type, attribute.normalized, offset);
+        glVertexArrayAttribBinding(entry.vao, attribute.location, 0);
+        offset += attribute.bytes;
+    }
+
+    std::cout << "VERTEX_LAYOUT::CREATED " << count << " attributes, stride " << offset << (divisor ? ", per instance" : "") << std::endl;
+
+    layouts.push_back(entry);
+    return entry.vao;
+}
+
+void VertexLayouts::bindBuffers(unsigned int vao, unsigned int vertexBuffer, GLintptr offset, GLsizei stride, unsigned int indexBuffer)
+{
+    for (LayoutEntry& entry : layouts)
+    {
+        if (entry.vao != vao)
+            continue;
+
+        if (entry.vertexBuffer != vertexBuffer || entry.offset != offset || entry.stride != stride)
+        {
+            glVertexArrayVertexBuffer(vao, 0, vertexBuffer, offset, stride);
+            entry.vertexBuffer = vertexBuffer;
+            entry.offset = offset;
+            entry.stride = stride;
+        }
+
+        if (entry.indexBuffer != indexBuffer)
+        {
+            glVertexArrayElementBuffer(vao, indexBuffer);
+            entry.indexBuffer = indexBuffer;
+        }
+        return;
+    }
+}
+
+void VertexLayouts::forgetBuffer(unsigned int buffer)
+{
+    if (!buffer)
+        return;
+
+    // Deleting a buffer only unbinds it from the bound VAO, the others would keep its storage alive
+    for (LayoutEntry& entry : layouts)
+    {
+        if (entry.vertexBuffer == buffer)
+        {
+            glVertexArrayVertexBuffer(entry.vao, 0, 0, 0, entry.stride);
+            entry.vertexBuffer = 0;
+        }
+
+        if (entry.indexBuffer == buffer)
+        {
+            glVertexArrayElementBuffer(entry.vao, 0);
+            entry.indexBuffer = 0;
+        }
+    }
+}
+
+void VertexLayouts::release()
+{
+    for (const LayoutEntry& entry : layouts)
+        glDeleteVertexArrays(1, &entry.vao);
+    layouts.clear();
+    released++;
+}
+
+unsigned int VertexLayouts::generation()
+{
+    return released;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// One attribute of a vertex format as the GL sees it. Offsets are not part of it, a layout packs its
+// attributes back to back in the order they are listed
+struct VertexAttribute
+{
+    GLuint location;
+    GLint components;
+    GLenum type;
+    GLboolean normalized;
+    bool integer;           // read as uint / int in the shader, through glVertexArrayAttribIFormat
+    GLuint bytes;
+};
+
+constexpr GLuint attributeTypeSize(GLenum type)
+{
+    return type == GL_BYTE || type == GL_UNSIGNED_BYTE ? 1 :
+           type == GL_SHORT || type == GL_UNSIGNED_SHORT || type == GL_HALF_FLOAT ? 2 : 4;
+}
+
+template<GLuint Location, GLint Components, GLenum Type, GLboolean Normalized = GL_FALSE, bool Integer = false>
+struct AttributeFormat
+{
+    static const GLuint location = Location;
+    static const GLint components = Components;
+    static const GLenum type = Type;
+    static const GLboolean normalized = Normalized;
+    static const bool integer = Integer;
+    static const GLuint bytes = Components * attributeTypeSize(Type);
+};
+
+// Locations follow the scene shaders: aPos 0, aTexCoord 1, aNormal 2, aObjectIndex 3. The debug line
+// shader reads its color where the texture coordinates would be
+struct Pos3f : AttributeFormat<0, 3, GL_FLOAT> {};
+struct Pos3s16n : AttributeFormat<0, 3, GL_SHORT, GL_TRUE> {};
+struct UV2f : AttributeFormat<1, 2, GL_FLOAT> {};
+struct UV2h : AttributeFormat<1, 2, GL_HALF_FLOAT> {};
+struct UV2u16n : AttributeFormat<1, 2, GL_UNSIGNED_SHORT, GL_TRUE> {};
+struct Color4u8n : AttributeFormat<1, 4, GL_UNSIGNED_BYTE, GL_TRUE> {};
+struct Normal3f : AttributeFormat<2, 3, GL_FLOAT> {};
+struct Normal2s8n : AttributeFormat<2, 2, GL_BYTE, GL_TRUE> {};     // octahedral
+struct ObjectIndex1u : AttributeFormat<3, 1, GL_UNSIGNED_INT, GL_FALSE, true> {};
+
+namespace VertexLayouts
+{
+    // VAO of a format on buffer binding 0, created the first time the format is asked for. Offsets
+    // are the running sum of the attribute sizes
+    unsigned int vertexArray(const VertexAttribute* attributes, std::size_t count, GLuint divisor);
+
+    // Points binding 0 and the element buffer of a layout's VAO at other buffers, skipped when they
+    // already are. The VAO does not have to be bound
+    void bindBuffers(unsigned int vao, unsigned int vertexBuffer, GLintptr offset, GLsizei stride, unsigned int indexBuffer);
+
+    // Call before deleting a buffer handed to bindBuffers. Detaches it from every VAO and drops the
+    // cached binding, a new buffer that gets the same name is bound again instead of skipped
+    void forgetBuffer(unsigned int buffer);
+
+    // Deletes every VAO created so far, the next vao() of a layout creates it again. A GLStateCache
+    // that had one bound needs invalidate()
+    void release();
+
+    // Counts release() calls, a layout's vao() refetches its VAO when this moved on
+    unsigned int generation();
+
+    template<typename... Attributes>
+    struct PackSize
+    {
+        static const GLuint value = 0;
+    };
+
+    template<typename First, typename... Rest>
+    struct PackSize<First, Rest...>
+    {
+        static const GLuint value = First::bytes + PackSize<Rest...>::value;
+    };
+
+    template<std::size_t Index, typename... Attributes>
+    struct PackOffset;
+
+    template<typename First, typename... Rest>
+    struct PackOffset<0, First, Rest...>
+    {
+        static const GLuint value = 0;
+    };
+
+    template<std::size_t Index, typename First, typename... Rest>
+    struct PackOffset<Index, First, Rest...>
+    {
+        static const GLuint value = First::bytes + PackOffset<Index - 1, Rest...>::value;
+    };
+}
+
+// A vertex format fixed at compile time, for example VertexLayout<Pos3f, UV2f>. Every mesh with the
+// same format draws through the same VAO, only the buffers bound to it are swapped between draws.
+// Compare stride and offset<I>() against the vertex struct with static_assert
+template<GLuint Divisor, typename... Attributes>
+struct BufferLayout
+{
+    static const GLsizei stride = GLsizei(VertexLayouts::PackSize<Attributes...>::value);
+
+    template<std::size_t Index>
+    static constexpr GLuint offset() { return VertexLayouts::PackOffset<Index, Attributes...>::value; }
+
+    // Created on first use, lives until VertexLayouts::release() or the end of the context. Remembered
+    // per layout type, only the first call and the first after a release() look the format up
+    static unsigned int vao()
+    {
+        static unsigned int id = 0;
+        static unsigned int generation = 0;
+        if (!id || generation != VertexLayouts::generation())
+        {
+            static const VertexAttribute attributes[] = { VertexAttribute{ Attributes::location, Attributes::components, Attributes::type,
+                                                                           Attributes::normalized, Attributes::integer, Attributes::bytes }... };
+            id = VertexLayouts::vertexArray(attributes, sizeof...(Attributes), Divisor);
+            generation = VertexLayouts::generation();
+        }
+        return id;
+    }
+
+    static void bindBuffers(unsigned int vertexBuffer, unsigned int indexBuffer = 0, GLintptr offset = 0)
+    {
+        VertexLayouts::bindBuffers(vao(), vertexBuffer, offset, stride, indexBuffer);
+    }
+};
+
+// One element per vertex, or one per instance for attributes like the object index
+template<typename... Attributes>
+using VertexLayout = BufferLayout<0, Attributes...>;
+
+template<typename... Attributes>
+using InstanceLayout = BufferLayout<1, Attributes...>;
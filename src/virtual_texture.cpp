@@ -0,0 +1,570 @@
+#include "virtual_texture.h"
+#include "gl_state.h"
+#include "shader.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+
+namespace
+{
+    const std::uint32_t NO_PAGE = 0xFFFFFFFFu;
+
+    int nextPowerOfTwo(int value)
+    {
+        int result = 1;
+        while (result < value)
+            result <<= 1;
+        return result;
+    }
+
+    int log2Int(int value)
+    {
+        int result = 0;
+        while (value >> (result + 1))
+            result++;
+        return result;
+    }
+}
+
+//-------------------------------------------------
+// Image page source
+//-------------------------------------------------
+
+ImagePageSource::ImagePageSource(const std::string& path, bool flipVertically)
+    : path(path), flipVertically(flipVertically)
+{
+    int channels;
+    if (!stbi_info(path.c_str(), &baseWidth, &baseHeight, &channels))
+        std::cerr << "ERROR::VIRTUAL_TEXTURE::SOURCE_NOT_READABLE " << path << std::endl;
+}
+
+int ImagePageSource::width() const
+{
+    return baseWidth;
+}
+
+int ImagePageSource::height() const
+{
+    return baseHeight;
+}
+
+bool ImagePageSource::decode()
+{
+    int w;
+    int h;
+    int channels;
+    stbi_set_flip_vertically_on_load_thread(flipVertically);
+    unsigned char* image = stbi_load(path.c_str(), &w, &h, &channels, 4);
+    if (!image)
+        return false;
+
+    levels.push_back(Level{ w, h, std::vector<unsigned char>(image, image + (std::size_t)w * h * 4) });
+    stbi_image_free(image);
+
+    // 2x2 box filter down to 1x1, odd edges reuse the last texel
+    while (levels.back().width > 1 || levels.back().height > 1)
+    {
+        const Level& src = levels.back();
+        Level dst;
+        dst.width = std::max(src.width / 2, 1);
+        dst.height = std::max(src.height / 2, 1);
+        dst.texels.resize((std::size_t)dst.width * dst.height * 4);
+
+        for (int y = 0; y < dst.height; y++)
+        {
+            int y0 = std::min(y * 2, src.height - 1);
+            int y1 = std::min(y * 2 + 1, src.height - 1);
+            for (int x = 0; x < dst.width; x++)
+            {
+                int x0 = std::min(x * 2, src.width - 1);
+                int x1 = std::min(x * 2 + 1, src.width - 1);
+                for (int c = 0; c < 4; c++)
+                {
+                    int sum = src.texels[((std::size_t)y0 * src.width + x0) * 4 + c] + src.texels[((std::size_t)y0 * src.width + x1) * 4 + c] +
+                              src.texels[((std::size_t)y1 * src.width + x0) * 4 + c] + src.texels[((std::size_t)y1 * src.width + x1) * 4 + c];
+                    dst.texels[((std::size_t)y * dst.width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+
+        levels.push_back(std::move(dst));
+    }
+
+    return true;
+}
+
+bool ImagePageSource::readPage(int mip, int pageX, int pageY, int pageSize, int border, unsigned char* rgba)
+{
+    std::call_once(decoded, [this]() { valid = decode(); });
+    if (!valid)
+        return false;
+
+    const Level& level = levels[std::min<std::size_t>(mip, levels.size() - 1)];
+    int size = pageSize + 2 * border;
+
+    for (int y = 0; y < size; y++)
+    {
+        int sy = std::min(std::max(pageY * pageSize - border + y, 0), level.height - 1);
+        for (int x = 0; x < size; x++)
+        {
+            int sx = std::min(std::max(pageX * pageSize - border + x, 0), level.width - 1);
+            std::memcpy(rgba + ((std::size_t)y * size + x) * 4, &level.texels[((std::size_t)sy * level.width + sx) * 4], 4);
+        }
+    }
+
+    return true;
+}
+
+//-------------------------------------------------
+// Virtual texture
+//-------------------------------------------------
+
+VirtualTexture::VirtualTexture(std::unique_ptr<PageSource> pageSource, const VirtualTextureSettings& settings, unsigned int id)
+    : source(std::move(pageSource)), settings(settings), id(id & 15)
+{
+    // Page ids in the feedback buffer have 12 bits per axis and 4 bits of mip
+    pagesX = std::min(nextPowerOfTwo((source->width() + settings.pageSize - 1) / settings.pageSize), 4096);
+    pagesY = std::min(nextPowerOfTwo((source->height() + settings.pageSize - 1) / settings.pageSize), 4096);
+    maxMip = std::min(log2Int(std::max(pagesX, pagesY)), 15);
+    slotSize = settings.pageSize + 2 * settings.border;
+
+    int cacheSize = settings.cachePages * slotSize;
+    glCreateTextures(GL_TEXTURE_2D, 1, &cache);
+    glTextureStorage2D(cache, 1, GL_RGBA8, cacheSize, cacheSize);
+    glTextureParameteri(cache, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(cache, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(cache, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(cache, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &pageTable);
+    glTextureStorage2D(pageTable, maxMip + 1, GL_RGBA8UI, pagesX, pagesY);
+    glTextureParameteri(pageTable, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(pageTable, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    for (int mip = 0; mip <= maxMip; mip++)
+    {
+        std::size_t entries = (std::size_t)levelPagesX(mip) * levelPagesY(mip);
+        table.push_back(std::vector<std::uint32_t>(entries, 0));
+        residentSlot.push_back(std::vector<int>(entries, -1));
+    }
+
+    slots.resize(settings.cachePages * settings.cachePages, Slot{ NO_PAGE, 0, false, false });
+
+    for (int i = 0; i < READBACK_FRAMES; i++)
+    {
+        readbackPBO[i] = 0;
+        readbackFence[i] = nullptr;
+        readbackWidth[i] = 0;
+        readbackHeight[i] = 0;
+    }
+
+    for (int i = 0; i < std::max(settings.workerThreads, 1); i++)
+        workers.emplace_back(&VirtualTexture::workerLoop, this);
+
+    // The coarsest level is requested first and never evicted, so every lookup gets a fallback.
+    // Nothing is decoded here, the first worker to run decodes the source
+    for (int y = 0; y < levelPagesY(maxMip); y++)
+        for (int x = 0; x < levelPagesX(maxMip); x++)
+            request(pageKey(maxMip, x, y));
+}
+
+VirtualTexture::~VirtualTexture()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+
+    for (int i = 0; i < READBACK_FRAMES; i++)
+    {
+        if (readbackFence[i])
+            glDeleteSync(readbackFence[i]);
+        if (readbackPBO[i])
+            glDeleteBuffers(1, &readbackPBO[i]);
+    }
+
+    if (feedbackFBO)
+    {
+        glDeleteFramebuffers(1, &feedbackFBO);
+        glDeleteTextures(1, &feedbackColor);
+        glDeleteRenderbuffers(1, &feedbackDepth);
+    }
+
+    glDeleteTextures(1, &cache);
+    glDeleteTextures(1, &pageTable);
+}
+
+void VirtualTexture::workerLoop()
+{
+    for (;;)
+    {
+        std::uint32_t key;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !requests.empty(); });
+            if (stopping)
+                return;
+            key = requests.front();
+            requests.pop_front();
+        }
+
+        Page page{ key, std::vector<unsigned char>((std::size_t)slotSize * slotSize * 4) };
+        int mip = (key >> 24) & 15;
+        int x = key & 0xFFF;
+        int y = (key >> 12) & 0xFFF;
+
+        // An empty page tells the main thread the request failed
+        if (!source->readPage(mip, x, y, settings.pageSize, settings.border, page.texels.data()))
+            page.texels.clear();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.push_back(std::move(page));
+    }
+}
+
+//-------------------------------------------------
+// Feedback pass
+//-------------------------------------------------
+
+void VirtualTexture::beginFeedback(GLStateCache& state, int viewportWidth, int viewportHeight)
+{
+    this->viewportWidth = viewportWidth;
+    this->viewportHeight = viewportHeight;
+
+    int width = std::max(viewportWidth / settings.feedbackScale, 1);
+    int height = std::max(viewportHeight / settings.feedbackScale, 1);
+
+    if (width != feedbackWidth || height != feedbackHeight)
+    {
+        if (feedbackFBO)
+        {
+            glDeleteFramebuffers(1, &feedbackFBO);
+            glDeleteTextures(1, &feedbackColor);
+            glDeleteRenderbuffers(1, &feedbackDepth);
+        }
+
+        glCreateTextures(GL_TEXTURE_2D, 1, &feedbackColor);
+        glTextureStorage2D(feedbackColor, 1, GL_R32UI, width, height);
+        glCreateRenderbuffers(1, &feedbackDepth);
+        glNamedRenderbufferStorage(feedbackDepth, GL_DEPTH_COMPONENT24, width, height);
+
+        glCreateFramebuffers(1, &feedbackFBO);
+        glNamedFramebufferTexture(feedbackFBO, GL_COLOR_ATTACHMENT0, feedbackColor, 0);
+        glNamedFramebufferRenderbuffer(feedbackFBO, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, feedbackDepth);
+        glNamedFramebufferReadBuffer(feedbackFBO, GL_COLOR_ATTACHMENT0);
+
+        if (glCheckNamedFramebufferStatus(feedbackFBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "ERROR::VIRTUAL_TEXTURE::FEEDBACK_FRAMEBUFFER_INCOMPLETE" << std::endl;
+
+        // In-flight readbacks refer to the old size, drop them
+        for (int i = 0; i < READBACK_FRAMES; i++)
+        {
+            if (readbackFence[i])
+                glDeleteSync(readbackFence[i]);
+            readbackFence[i] = nullptr;
+
+            if (readbackPBO[i])
+                glDeleteBuffers(1, &readbackPBO[i]);
+            glCreateBuffers(1, &readbackPBO[i]);
+            glNamedBufferStorage(readbackPBO[i], (GLsizeiptr)width * height * sizeof(std::uint32_t), nullptr, GL_MAP_READ_BIT);
+        }
+
+        feedbackWidth = width;
+        feedbackHeight = height;
+    }
+
+    state.bindFramebuffer(feedbackFBO);
+    state.viewport(0, 0, feedbackWidth, feedbackHeight);
+
+    const GLuint clearId[4] = { NO_PAGE, NO_PAGE, NO_PAGE, NO_PAGE };
+    const GLfloat clearDepth = 1.0f;
+    glClearNamedFramebufferuiv(feedbackFBO, GL_COLOR, 0, clearId);
+    glClearNamedFramebufferfv(feedbackFBO, GL_DEPTH, 0, &clearDepth);
+}
+
+void VirtualTexture::endFeedback(GLStateCache& state)
+{
+    // The oldest readback gets overwritten if it was never consumed
+    int slot = readbackHead;
+    if (readbackFence[slot])
+        glDeleteSync(readbackFence[slot]);
+
+    state.bindBuffer(GL_PIXEL_PACK_BUFFER, readbackPBO[slot]);
+    glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readbackFence[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readbackWidth[slot] = feedbackWidth;
+    readbackHeight[slot] = feedbackHeight;
+    readbackHead = (readbackHead + 1) % READBACK_FRAMES;
+
+    state.bindFramebuffer(0);
+    state.viewport(0, 0, viewportWidth, viewportHeight);
+}
+
+//-------------------------------------------------
+// Streaming
+//-------------------------------------------------
+
+void VirtualTexture::update()
+{
+    frame++;
+
+    for (Slot& slot : slots)
+        slot.used = false;
+
+    // Only readbacks the GPU is done with, never waits
+    for (int i = 0; i < READBACK_FRAMES; i++)
+    {
+        int slot = (readbackHead + i) % READBACK_FRAMES;
+        if (!readbackFence[slot])
+            continue;
+
+        GLenum status = glClientWaitSync(readbackFence[slot], 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            continue;
+
+        glDeleteSync(readbackFence[slot]);
+        readbackFence[slot] = nullptr;
+
+        std::size_t count = (std::size_t)readbackWidth[slot] * readbackHeight[slot];
+        const std::uint32_t* ids = (const std::uint32_t*)glMapNamedBufferRange(readbackPBO[slot], 0, count * sizeof(std::uint32_t), GL_MAP_READ_BIT);
+        if (ids)
+        {
+            processFeedback(ids, count);
+            glUnmapNamedBuffer(readbackPBO[slot]);
+        }
+    }
+
+    std::vector<Page> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (!finished.empty() && (int)ready.size() < settings.maxUploadsPerFrame)
+        {
+            ready.push_back(std::move(finished.front()));
+            finished.pop_front();
+        }
+    }
+
+    // Pages that find no free slot are dropped, the feedback will ask for them again
+    for (const Page& page : ready)
+    {
+        pending.erase(page.key);
+        if (!page.texels.empty())
+            upload(page, int((page.key >> 24) & 15) == maxMip);
+    }
+}
+
+void VirtualTexture::processFeedback(const std::uint32_t* ids, std::size_t count)
+{
+    std::vector<std::uint32_t> unique(ids, ids + count);
+    std::sort(unique.begin(), unique.end());
+    unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+    std::vector<std::uint32_t> wanted;
+    for (std::uint32_t value : unique)
+    {
+        if (value == NO_PAGE || (value >> 28) != id)
+            continue;
+
+        int mip = (value >> 24) & 15;
+        int x = value & 0xFFF;
+        int y = (value >> 12) & 0xFFF;
+        if (mip > maxMip || x >= levelPagesX(mip) || y >= levelPagesY(mip))
+            continue;
+
+        // Walk up to the page actually used for this pixel, queueing everything missing on the way
+        while (mip <= maxMip)
+        {
+            int slot = residentSlot[mip][(std::size_t)y * levelPagesX(mip) + x];
+            if (slot >= 0)
+            {
+                slots[slot].lastUsed = frame;
+                slots[slot].used = true;
+                break;
+            }
+
+            wanted.push_back(pageKey(mip, x, y));
+            mip++;
+            x >>= 1;
+            y >>= 1;
+        }
+    }
+
+    // Coarse pages first, they unblock the most texels. The mip sits in the top bits of the key, so
+    // sorting whole keys orders by mip and puts duplicates next to each other
+    std::sort(wanted.begin(), wanted.end(), std::greater<std::uint32_t>());
+    wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+
+    for (std::uint32_t key : wanted)
+    {
+        if ((int)pending.size() >= settings.maxPendingPages)
+            break;
+        request(key);
+    }
+}
+
+void VirtualTexture::request(std::uint32_t key)
+{
+    if (!pending.insert(key).second)
+        return;
+
+    pagesRequested++;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(key);
+    }
+    wake.notify_one();
+}
+
+bool VirtualTexture::upload(const Page& page, bool pin)
+{
+    int mip = (page.key >> 24) & 15;
+    int x = page.key & 0xFFF;
+    int y = (page.key >> 12) & 0xFFF;
+
+    int& resident = residentSlot[mip][(std::size_t)y * levelPagesX(mip) + x];
+    if (resident >= 0)
+        return true;
+
+    int slot = allocateSlot();
+    if (slot < 0)
+        return false;
+
+    int slotX = slot % settings.cachePages;
+    int slotY = slot / settings.cachePages;
+    glTextureSubImage2D(cache, 0, slotX * slotSize, slotY * slotSize, slotSize, slotSize, GL_RGBA, GL_UNSIGNED_BYTE, page.texels.data());
+
+    slots[slot] = Slot{ page.key, frame, true, pin };
+    resident = slot;
+    pagesUploaded++;
+
+    refreshPageTable(mip, x, y);
+    return true;
+}
+
+int VirtualTexture::allocateSlot()
+{
+    int victim = -1;
+    for (int i = 0; i < (int)slots.size(); i++)
+    {
+        const Slot& slot = slots[i];
+        if (slot.key == NO_PAGE)
+            return i;
+
+        // Least recently used, but never something the current frame still samples
+        if (slot.pinned || slot.used)
+            continue;
+        if (victim < 0 || slot.lastUsed < slots[victim].lastUsed)
+            victim = i;
+    }
+
+    if (victim < 0)
+        return -1;
+
+    std::uint32_t key = slots[victim].key;
+    int mip = (key >> 24) & 15;
+    int x = key & 0xFFF;
+    int y = (key >> 12) & 0xFFF;
+
+    residentSlot[mip][(std::size_t)y * levelPagesX(mip) + x] = -1;
+    slots[victim].key = NO_PAGE;
+    pagesEvicted++;
+
+    refreshPageTable(mip, x, y);
+    return victim;
+}
+
+// Recomputes every entry below the changed page: resident pages point at themselves,
+// the rest inherit the entry of their parent so lookups fall back to the closest coarser page
+void VirtualTexture::refreshPageTable(int mip, int x, int y)
+{
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    for (int level = mip; level >= 0; level--)
+    {
+        int scale = 1 << (mip - level);
+        int levelWidth = levelPagesX(level);
+        int levelHeight = levelPagesY(level);
+
+        int x0 = x * scale;
+        int y0 = y * scale;
+        if (x0 >= levelWidth || y0 >= levelHeight)
+            break;
+
+        int width = std::min(scale, levelWidth - x0);
+        int height = std::min(scale, levelHeight - y0);
+
+        for (int py = y0; py < y0 + height; py++)
+        {
+            for (int px = x0; px < x0 + width; px++)
+            {
+                std::size_t index = (std::size_t)py * levelWidth + px;
+                int slot = residentSlot[level][index];
+
+                if (slot >= 0)
+                    table[level][index] = std::uint32_t(slot % settings.cachePages) | std::uint32_t(slot / settings.cachePages) << 8 |
+                                          std::uint32_t(level) << 16 | 1u << 24;
+                else if (level < maxMip)
+                    table[level][index] = table[level + 1][(std::size_t)(py >> 1) * levelPagesX(level + 1) + (px >> 1)];
+                else
+                    table[level][index] = 0;
+            }
+        }
+
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, levelWidth);
+        glTextureSubImage2D(pageTable, level, x0, y0, width, height, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, &table[level][(std::size_t)y0 * levelWidth + x0]);
+    }
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+//-------------------------------------------------
+// Rendering
+//-------------------------------------------------
+
+void VirtualTexture::bind(GLStateCache& state, unsigned int cacheUnit, unsigned int pageTableUnit) const
+{
+    state.bindTexture(cacheUnit, cache);
+    state.bindTexture(pageTableUnit, pageTable);
+    state.bindSampler(cacheUnit, 0);
+    state.bindSampler(pageTableUnit, 0);
+}
+
+// Goes through glProgramUniform, the program does not have to be bound
+void VirtualTexture::setUniforms(const Shader& shader, bool feedback) const
+{
+    shader.setVec2("vtSize", (float)source->width(), (float)source->height());
+    shader.setInt("vtMaxMip", maxMip);
+    shader.setFloat("vtPageSize", (float)settings.pageSize);
+
+    if (feedback)
+    {
+        shader.setInt("vtId", (int)id);
+        shader.setFloat("vtFeedbackBias", std::log2((float)settings.feedbackScale));
+    }
+    else
+    {
+        shader.setFloat("vtBorder", (float)settings.border);
+        shader.setFloat("vtCacheSize", (float)(settings.cachePages * slotSize));
+    }
+}
+
+void VirtualTexture::printStats() const
+{
+    std::size_t resident = 0;
+    for (const Slot& slot : slots)
+        if (slot.key != NO_PAGE)
+            resident++;
+
+    std::cout << "VIRTUAL_TEXTURE: " << resident << "/" << slots.size() << " pages resident, "
+              << pagesRequested << " requested, " << pagesUploaded << " uploaded, " << pagesEvicted << " evicted" << std::endl;
+}
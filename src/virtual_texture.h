@@ -0,0 +1,187 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class GLStateCache;
+class Shader;
+
+// Texture units bind() is usually given, fixed in vt_fragment.glsl with layout(binding = 1) and 2
+const unsigned int VT_CACHE_UNIT = 1;
+const unsigned int VT_PAGE_TABLE_UNIT = 2;
+
+// Where the texels of a virtual texture come from. readPage is called from worker threads
+class PageSource
+{
+public:
+    virtual ~PageSource() {}
+
+    virtual int width() const = 0;
+    virtual int height() const = 0;
+
+    // Writes a (pageSize + 2 * border)^2 RGBA8 page of the given mip, border texels are clamped to the image
+    virtual bool readPage(int mip, int pageX, int pageY, int pageSize, int border, unsigned char* rgba) = 0;
+};
+
+// Decodes the image through stb_image on the first worker that asks for a page and keeps a box
+// filtered mip pyramid around, the constructor only reads the header. stb_image cannot decode a
+// region on its own, a pre-tiled file on disk would replace this for really big sets
+class ImagePageSource : public PageSource
+{
+public:
+    // Flipped with the thread local stb_image setting, so texture loads on other threads are not affected
+    explicit ImagePageSource(const std::string& path, bool flipVertically = false);
+
+    int width() const override;
+    int height() const override;
+
+    bool readPage(int mip, int pageX, int pageY, int pageSize, int border, unsigned char* rgba) override;
+
+private:
+    bool decode();
+
+    std::string path;
+    bool flipVertically;
+    std::once_flag decoded;
+    bool valid = false;
+
+    struct Level
+    {
+        int width;
+        int height;
+        std::vector<unsigned char> texels;
+    };
+    std::vector<Level> levels;
+
+    int baseWidth = 0;
+    int baseHeight = 0;
+};
+
+struct VirtualTextureSettings
+{
+    int pageSize = 128;             // texels of payload per page side
+    int border = 4;                 // filtering border around each page in the cache
+    int cachePages = 16;            // physical cache is cachePages x cachePages pages
+    int feedbackScale = 8;          // feedback target is the viewport divided by this
+    int maxUploadsPerFrame = 8;
+    int maxPendingPages = 64;
+    int workerThreads = 2;
+};
+
+// Sparse virtual texture with a fixed size physical page cache and an indirection page table.
+// A low resolution feedback pass writes the pages the frame wants, the ids are read back a few
+// frames later without stalling, decoded on worker threads and uploaded into free cache slots.
+// The pinned coarsest level goes through the workers as well, until it arrives lookups return grey.
+// GPU memory stays the same however large the source is
+class VirtualTexture
+{
+public:
+    unsigned int pageTable;
+    unsigned int cache;
+
+    VirtualTexture(std::unique_ptr<PageSource> source, const VirtualTextureSettings& settings = VirtualTextureSettings(), unsigned int id = 0);
+    ~VirtualTexture();
+
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+    // Draw the scene with the vt_feedback shader between these two calls. The framebuffer, viewport
+    // and readback binds go through the state cache, endFeedback leaves the window framebuffer
+    // bound with a viewport of the size given here
+    void beginFeedback(GLStateCache& state, int viewportWidth, int viewportHeight);
+    void endFeedback(GLStateCache& state);
+
+    // Consumes finished readbacks and decoded pages, call once per frame after endFeedback
+    void update();
+
+    // The cache relies on its own clamp-to-edge bilinear parameters, both units get sampler 0
+    void bind(GLStateCache& state, unsigned int cacheUnit, unsigned int pageTableUnit) const;
+
+    // Sizes and ids the vt shaders need, all fixed for the texture's lifetime. Call once per program
+    // after it is built, a hot reload carries the values over to the new program
+    void setUniforms(const Shader& shader, bool feedback) const;
+
+    void printStats() const;
+
+private:
+    struct Slot
+    {
+        std::uint32_t key;
+        std::uint64_t lastUsed;
+        bool used;
+        bool pinned;
+    };
+
+    struct Page
+    {
+        std::uint32_t key;
+        std::vector<unsigned char> texels;
+    };
+
+    static std::uint32_t pageKey(int mip, int x, int y) { return (std::uint32_t(mip) << 24) | (std::uint32_t(y) << 12) | std::uint32_t(x); }
+
+    void workerLoop();
+    void request(std::uint32_t key);
+    void processFeedback(const std::uint32_t* ids, std::size_t count);
+    bool upload(const Page& page, bool pin);
+    int allocateSlot();
+    void refreshPageTable(int mip, int x, int y);
+
+    int levelPagesX(int mip) const { return pagesX >> mip ? pagesX >> mip : 1; }
+    int levelPagesY(int mip) const { return pagesY >> mip ? pagesY >> mip : 1; }
+
+    std::unique_ptr<PageSource> source;
+    VirtualTextureSettings settings;
+    unsigned int id;
+
+    int pagesX;
+    int pagesY;
+    int maxMip;
+    int slotSize;
+
+    // Page table mirror, one RGBA8UI entry per page: cache slot x/y, mip actually resident, valid
+    std::vector<std::vector<std::uint32_t>> table;
+    std::vector<std::vector<int>> residentSlot;
+
+    std::vector<Slot> slots;
+    std::uint64_t frame = 0;
+
+    // Feedback target and the readback ring
+    static const int READBACK_FRAMES = 3;
+    unsigned int feedbackFBO = 0;
+    unsigned int feedbackColor = 0;
+    unsigned int feedbackDepth = 0;
+    int feedbackWidth = 0;
+    int feedbackHeight = 0;
+    unsigned int readbackPBO[READBACK_FRAMES];
+    GLsync readbackFence[READBACK_FRAMES];
+    int readbackWidth[READBACK_FRAMES];
+    int readbackHeight[READBACK_FRAMES];
+    int readbackHead = 0;
+    int viewportWidth = 0;
+    int viewportHeight = 0;
+
+    // Worker side, guarded by mutex
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::uint32_t> requests;
+    std::deque<Page> finished;
+    bool stopping = false;
+
+    std::unordered_set<std::uint32_t> pending;
+
+    unsigned int pagesUploaded = 0;
+    unsigned int pagesEvicted = 0;
+    unsigned int pagesRequested = 0;
+};
@@ -0,0 +1,224 @@
+// Offline converter from Wavefront OBJ to the .pmesh format loaded by MeshFile.
+//
+//     mesh_convert [--compress] input.obj output.pmesh
+//
+// Faces are triangulated as fans, every usemtl starts a submesh. Each submesh is welded and
+// reordered on its own, then the whole mesh is quantized against one set of bounds. With
+// --compress the vertex and index streams go through MeshCodec
+
+#include "mesh.h"
+#include "mesh_file.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Group
+    {
+        std::string name;
+        std::vector<Vertex> triangles;
+        std::vector<bool> hasNormals;   // per triangle
+    };
+
+    // OBJ indices are 1 based, negative ones count back from the last element
+    int resolve(const std::string& token, std::size_t count)
+    {
+        if (token.empty())
+            return -1;
+
+        long index = std::strtol(token.c_str(), nullptr, 10);
+        if (index < 0)
+            index += long(count);
+        else
+            index -= 1;
+
+        return index >= 0 && index < long(count) ? int(index) : -1;
+    }
+
+    bool parseObj(const std::string& path, std::vector<Group>& groups)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            std::cout << "ERROR::MESH_CONVERT::FILE_NOT_SUCCESSFULLY_READ " << path << std::endl;
+            return false;
+        }
+
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec2> texCoords;
+        std::vector<glm::vec3> normals;
+
+        groups.push_back(Group());
+        groups.back().name = "default";
+
+        std::string line;
+        std::size_t lineNumber = 0;
+        while (std::getline(file, line))
+        {
+            lineNumber++;
+
+            std::istringstream stream(line);
+            std::string keyword;
+            stream >> keyword;
+
+            if (keyword == "v")
+            {
+                glm::vec3 position(0.0f);
+                stream >> position.x >> position.y >> position.z;
+                positions.push_back(position);
+            }
+            else if (keyword == "vt")
+            {
+                glm::vec2 texCoord(0.0f);
+                stream >> texCoord.x >> texCoord.y;
+                texCoords.push_back(texCoord);
+            }
+            else if (keyword == "vn")
+            {
+                glm::vec3 normal(0.0f);
+                stream >> normal.x >> normal.y >> normal.z;
+                normals.push_back(normal);
+            }
+            else if (keyword == "usemtl")
+            {
+                std::string material;
+                stream >> material;
+
+                // Nothing drawn with the previous material yet, just rename it
+                if (groups.back().triangles.empty())
+                    groups.back().name = material;
+                else
+                {
+                    groups.push_back(Group());
+                    groups.back().name = material;
+                }
+            }
+            else if (keyword == "f")
+            {
+                std::vector<Vertex> polygon;
+                bool withNormals = true;
+
+                std::string corner;
+                while (stream >> corner)
+                {
+                    // v, v/vt, v//vn or v/vt/vn
+                    std::size_t first = corner.find('/');
+                    std::size_t second = first == std::string::npos ? std::string::npos : corner.find('/', first + 1);
+
+                    int position = resolve(corner.substr(0, first), positions.size());
+                    int texCoord = first == std::string::npos ? -1 : resolve(corner.substr(first + 1, second - first - 1), texCoords.size());
+                    int normal = second == std::string::npos ? -1 : resolve(corner.substr(second + 1), normals.size());
+
+                    if (position < 0)
+                    {
+                        std::cout << "ERROR::MESH_CONVERT::BAD_INDEX line " << lineNumber << std::endl;
+                        return false;
+                    }
+
+                    Vertex vertex;
+                    vertex.position = positions[position];
+                    vertex.texCoord = texCoord >= 0 ? texCoords[texCoord] : glm::vec2(0.0f);
+                    vertex.normal = normal >= 0 ? glm::normalize(normals[normal]) : glm::vec3(0.0f);
+                    withNormals = withNormals && normal >= 0;
+                    polygon.push_back(vertex);
+                }
+
+                Group& group = groups.back();
+                for (std::size_t i = 2; i < polygon.size(); i++)
+                {
+                    group.triangles.push_back(polygon[0]);
+                    group.triangles.push_back(polygon[i - 1]);
+                    group.triangles.push_back(polygon[i]);
+                    group.hasNormals.push_back(withNormals);
+                }
+            }
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    bool compress = argc == 4 && std::string(argv[1]) == "--compress";
+    if (argc != 3 && !compress)
+    {
+        std::cout << "usage: mesh_convert [--compress] input.obj output.pmesh" << std::endl;
+        return 1;
+    }
+
+    const char* input = argv[argc - 2];
+    const char* output = argv[argc - 1];
+
+    std::vector<Group> groups;
+    if (!parseObj(input, groups))
+        return 1;
+
+    std::vector<MeshData> parts;
+    for (Group& group : groups)
+    {
+        if (group.triangles.empty())
+            continue;
+
+        // Triangles without normals in the file get their face normal
+        std::vector<Vertex> flat(group.triangles);
+        MeshBuilder::faceNormals(flat);
+        for (std::size_t i = 0; i < group.hasNormals.size(); i++)
+            if (!group.hasNormals[i])
+                for (int corner = 0; corner < 3; corner++)
+                    group.triangles[i * 3 + corner].normal = flat[i * 3 + corner].normal;
+
+        parts.push_back(MeshBuilder::build(group.triangles, group.name));
+    }
+
+    // Level by level, so every level of the file is one contiguous range over all submeshes. Parts
+    // that ran out of levels repeat their coarsest one
+    std::size_t levels = 0;
+    for (const MeshData& part : parts)
+        levels = std::max(levels, part.lods.size());
+
+    MeshData combined;
+    std::vector<std::uint32_t> vertexBase;
+    for (const MeshData& part : parts)
+    {
+        vertexBase.push_back(std::uint32_t(combined.vertices.size()));
+        combined.vertices.insert(combined.vertices.end(), part.vertices.begin(), part.vertices.end());
+    }
+
+    for (std::size_t level = 0; level < levels; level++)
+    {
+        MeshLod lod = { std::uint32_t(combined.indices.size()), 0, 0.0f, 0 };
+        for (std::size_t i = 0; i < parts.size(); i++)
+        {
+            const MeshLod& range = parts[i].lods[std::min(level, parts[i].lods.size() - 1)];
+            std::uint32_t firstIndex = std::uint32_t(combined.indices.size());
+            for (std::uint32_t index = range.firstIndex; index < range.firstIndex + range.indexCount; index++)
+                combined.indices.push_back(vertexBase[i] + parts[i].indices[index]);
+
+            if (level == 0)
+                combined.submeshes.push_back(MeshBuilder::submesh(combined, firstIndex, range.indexCount));
+            lod.error = std::max(lod.error, range.error);
+        }
+        lod.indexCount = std::uint32_t(combined.indices.size()) - lod.firstIndex;
+        combined.lods.push_back(lod);
+    }
+
+    if (combined.indices.empty())
+    {
+        std::cout << "ERROR::MESH_CONVERT::NO_TRIANGLES " << input << std::endl;
+        return 1;
+    }
+
+    PackedMesh packed = MeshBuilder::pack(combined, input);
+    if (!MeshFile::write(output, packed, compress))
+        return 1;
+
+    std::cout << "MESH_CONVERT::WROTE " << output << std::endl;
+    return 0;
+}